@@ -0,0 +1,79 @@
+#include "BoilerLink.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+BoilerLink::BoilerLink(BoilerPort &port)
+: _port(port), _state(IDLE), _cmd(NULL), _timeout(0), _retries(0), _expected(0), _sent(0), _received(0), _length(0),
+  stale(0), framing(0)
+{
+}
+
+void BoilerLink::_send()
+{
+  stale += _port.discard();         // whatever arrived late for the previous command
+  _length = 0;
+  _sent = millis();
+  _port.print(_cmd);
+  _state = BUSY;
+}
+
+bool BoilerLink::send(const char *cmd, uint16_t timeout, uint8_t retries, uint8_t expected)
+{
+  if (_state == BUSY)
+    return false;
+
+  _cmd = cmd;
+  _timeout = timeout;
+  _retries = retries;
+  _expected = expected;
+  _send();
+  return true;
+}
+
+BoilerLink::State BoilerLink::_retry(State failure)
+{
+  if (_retries == 0)
+    return _state = failure;
+
+  _retries--;
+  _send();                          // try again
+  return BUSY;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// collect what has arrived since the last call, never waits
+////////////////////////////////////////////////////////////////////////////////////////////
+BoilerLink::State BoilerLink::loop()
+{
+  if (_state != BUSY) {
+    _state = IDLE;                  // COMPLETE, TIMEOUT and FRAMING are reported only once
+    return IDLE;
+  }
+  uint32_t now = millis();
+
+  int lg = _port.readBytes(_buffer + _length, BOILER_LINK_BUFFER - _length);
+  if (lg > 0) {
+    _length += lg;
+    _received = now;
+  }
+
+  if (_length == 0)
+  {
+    if (now - _sent < _timeout)
+      return BUSY;                  // still waiting for the first byte
+    return _retry(TIMEOUT);
+  }
+
+  if (_expected && _length >= _expected)
+    return _state = COMPLETE;       // no need to wait for the boiler to go quiet
+
+  if (_length < BOILER_LINK_BUFFER && now - _received < BOILER_LINK_QUIET)
+    return BUSY;                    // boiler may still be sending
+
+  if (_expected && _length < _expected) {
+    framing++;                      // a half frame, never decode it
+    return _retry(FRAMING);
+  }
+  return _state = COMPLETE;
+}
@@ -0,0 +1,63 @@
+/*
+ * Non-blocking request/response handling with the boiler
+ *
+ * send() writes the command and returns immediately. Subsequent calls to loop() collect the
+ * bytes as they arrive, and report COMPLETE once the expected length has been received or the
+ * boiler has stopped sending, or TIMEOUT when the boiler did not respond within the timeout,
+ * after all retries have been used. A response shorter than expected is retried as well, and
+ * reported as FRAMING when it remains short. Stale bytes are dropped before each send.
+ */
+#ifndef BOILER_LINK
+#define BOILER_LINK
+
+#include <Arduino.h>
+#include "BoilerPort.h"
+
+#ifndef BOILER_LINK_BUFFER
+#define BOILER_LINK_BUFFER  64    // max bytes in a response
+#endif
+#define BOILER_LINK_QUIET   15    // ms without new bytes which marks the end of a response
+
+class BoilerLink
+{
+public:
+  enum State {
+    IDLE,       // no command pending
+    BUSY,       // command send, awaiting (the rest of) the response
+    COMPLETE,   // response received, available in frame()
+    TIMEOUT,    // no response, also not after retrying
+    FRAMING,    // response shorter than expected, also after retrying
+  };
+
+private:
+  BoilerPort  &_port;
+  State       _state;
+  const char *_cmd;
+  uint16_t    _timeout;       // ms to wait for the first byte
+  uint8_t     _retries;       // retries left
+  uint8_t     _expected;      // length of the response, 0 when unknown
+  uint32_t    _sent;          // ms timestamp the command was send
+  uint32_t    _received;      // ms timestamp the last byte was received
+  byte        _buffer[BOILER_LINK_BUFFER];
+  int         _length;
+
+  void  _send();
+  State _retry(State failure);
+public:
+  uint32_t    stale;          // bytes dropped before sending, left from a previous response
+  uint32_t    framing;        // responses shorter than expected
+
+  BoilerLink(BoilerPort &port);
+
+  bool  send(const char *cmd, uint16_t timeout, uint8_t retries, uint8_t expected = 0);   // returns false when still busy
+  State loop();                                                     // returns COMPLETE, TIMEOUT or FRAMING only once
+
+  bool        busy()    const { return _state == BUSY; }
+  const char *command() const { return _cmd; }
+  const byte *frame()   const { return _buffer; }
+  int         length()  const { return _length; }
+  uint32_t    elapsed() const { return _received - _sent; }  // ms from sending the command until its last byte
+  uint32_t    errors()  const { return framing + _port.errors(); }
+};
+
+#endif
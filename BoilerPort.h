@@ -0,0 +1,24 @@
+/*
+ * The serial connection to the boiler
+ *
+ * Implemented by WemosSerial for the real boiler connected on the X5 connector,
+ * and by BoilerSimulator to replay recorded sessions without a boiler connected
+ */
+#ifndef BOILER_PORT
+#define BOILER_PORT
+
+#include <Arduino.h>
+
+class BoilerPort
+{
+public:
+  virtual bool begin(int baudrate, int rx_buffer = 256) = 0;
+  virtual bool print(const char*s) = 0;
+  virtual int  available() = 0;
+  virtual int  read() = 0;
+  virtual int  readBytes(byte *buffer, int length) = 0;   // what has arrived, up to length, never waits
+  virtual int  discard() = 0;                             // drop what has arrived, returns the bytes dropped
+  virtual uint32_t errors() { return 0; };                // framing and overrun errors seen by the UART
+};
+
+#endif
@@ -0,0 +1,320 @@
+#include "BoilerSimulator.h"
+#include <string.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Recorded sessions from Protocol.txt, a central heating burn cycle followed by a hot water tap
+// temperatures, pressure and io current in 1/100, fan speeds in rpm, pwm in 1/10 %
+struct Recording {
+  int16_t T_boiler, T_boiler_out, T_boiler_in, T_ww_out, pressure, T_set;
+  int16_t fan_set, fan_cur, fan_pwm, io_curr;
+  uint8_t bstate;
+};
+
+static const Recording SESSION[] PROGMEM = {
+  // central heating
+  {  4627,  4124,  3877,  5414,  117, 4000,    0,    0,    0,    0, 126 },
+  {  4533,  4068,  3839,  5414,  117, 4000,    0,    0,    0,    0, 126 },
+  {  4441,  4012,  3802,  5403,  118, 4000,    0,    0,    0,    0, 126 },
+  {  4354,  3961,  3768,  5395,  130, 4000, 2350, 1435,  866,    0,   0 },
+  {  4279,  3912,  3732,  5391,  131, 4000, 2350, 2381,  284,  664,   0 },
+  {  4728,  3971,  3599,  5324,  117, 3800, 1410, 1409,  196,  537,   0 },
+  {  4817,  4003,  3603,  5313,  119, 3900, 1551, 1586,  190,  590,   0 },
+  {  4897,  4031,  3605,  5301,  119, 4000, 1703, 1641,  272,  602,   0 },
+  {  4977,  4061,  3611,  5293,  119, 4000, 1629, 1657,  196,  624,   0 },
+  {  5052,  4086,  3611,  5290,  119, 4000, 1564, 1579,  192,  622,   0 },
+  {  5125,  4112,  3614,  5279,  119, 4000, 1494, 1504,  187,  612,   0 },
+  {  5198,  4143,  3624,  5268,  118, 4000, 1410, 1419,  180,  604,   0 },
+  {  5268,  4173,  3635,  5256,  117, 4000, 1410, 1402,  196,  596,   0 },
+  {  5336,  4203,  3645,  5245,  117, 4000, 1410, 1407,  196,  602,   0 },
+  {  5394,  4230,  3657,  5245,  117, 4000, 1410, 1409,  195,  601,   0 },
+  {  5447,  4252,  3664,  5240,  118, 4000, 1410, 1410,  195,  609,   0 },
+  {  5498,  4275,  3674,  5234,  118, 4000, 1410, 1410,  195,  618,   0 },
+  {  5548,  4300,  3686,  5223,  117, 4000, 1410, 1410,  195,  620,   0 },
+  {  5595,  4324,  3698,  5210,  117, 4000, 1410, 1410,  195,  621,   0 },
+  {  5636,  4345,  3710,  5205,  118, 4000, 1410, 1410,  195,  631,   0 },
+  {  5677,  4364,  3718,  5199,  118, 4000, 1410, 1410,  195,  631,   0 },
+  {  5715,  4385,  3731,  5188,  117, 4000, 1410, 1410,  195,  628,   0 },
+  {  5750,  4408,  3748,  5188,  117, 4000, 1410, 1410,  195,  639,   0 },
+  {  5783,  4427,  3760,  5177,  118, 4000, 1410, 1410,  195,  636,   0 },
+  {  5814,  4444,  3770,  5177,  118, 4000, 1410, 1410,  195,  644,   0 },
+  {  5846,  4461,  3780,  5165,  118, 4000, 1410, 1410,  195,  639,   0 },
+  {  5874,  4475,  3787,  5161,  118, 4000, 1410, 1410,  195,  643,   0 },
+  {  5903,  4495,  3802,  5154,  118, 4000, 1410, 1410,  195,  651,   0 },
+  {  5938,  4510,  3807,  5143,  131, 4000, 2350, 2294,  377,    0,   0 },
+  {  5961,  4525,  3818,  5132,  131, 4000, 2350, 2396,  276,    0,   0 },
+  {  5974,  4535,  3827,  5125,  130, 4000,    0, 2068,    0,    0, 231 },
+  {  5951,  4529,  3829,  5122,  118, 4000,    0, 1527,    0,    0, 231 },
+  {  5894,  4517,  3840,  5120,  118, 4000,    0, 1149,    0,    0, 231 },
+  {  5821,  4493,  3840,  5114,  117, 4000,    0,  863,    0,    0, 231 },
+  {  5730,  4463,  3840,  5109,  117, 4000,    0,  633,    0,    0, 231 },
+  {  5635,  4431,  3838,  5098,  117, 4000,    0,    0,    0,    0, 126 },
+  {  5532,  4395,  3835,  5095,  117, 4000,    0,    0,    0,    0, 126 },
+  // hot water
+  {  3638,  3540,  3493,  3169,  117, 4000,    0,    0,    0,    0, 126 },
+  {  3630,  3538,  3493,  3169,  117, 4000,    0,    0,    0,    0, 126 },
+  {  3629,  3535,  3490,  3184,  117, 5500, 2350,    0,  738,    0, 204 },
+  {  3618,  3532,  3490,  3371,  105, 5500, 4700, 2417,  728,  566, 204 },
+  {  3607,  3528,  3490,  3217,  106, 5500, 4700, 4359,  674,  746, 204 },
+  {  3620,  3532,  3490,  3152,  105, 5500, 5100, 4892,  752,  766, 204 },
+  {  3695,  3561,  3495,  3292,  106, 5500, 5100, 5063,  681,  790, 204 },
+  {  3852,  3626,  3516,  3545,  106, 5500, 5100, 5086,  680,  796, 204 },
+  {  4087,  3736,  3564,  3851,  106, 5500, 5100, 5095,  679,  801, 204 },
+  {  4392,  3888,  3641,  4165,  105, 5500, 5100, 5098,  680,  813, 204 },
+  {  4742,  4073,  3744,  4467,  106, 5500, 5039, 5093,  637,  820, 204 },
+  {  5121,  4280,  3867,  4740,  106, 5500, 4493, 4635,  488,  823, 204 },
+  {  5508,  4497,  4000,  4998,  105, 5500, 3977, 4115,  399,  828, 204 },
+  {  5911,  4729,  4148,  5234,  106, 5500, 3523, 3627,  344,  835, 204 },
+  {  6276,  4946,  4291,  5414,  106, 5500, 3171, 3245,  308,  836, 204 },
+  {  6605,  5148,  4431,  5541,  106, 5500, 2918, 2969,  290,  841, 204 },
+  {  6900,  5334,  4564,  5646,  106, 5500, 2663, 2705,  263,  840, 204 },
+  {  7149,  5498,  4686,  5725,  106, 5500, 2416, 2450,  239,  836, 204 },
+  {  7351,  5639,  4797,  5793,  106, 5500, 2228, 2246,  232,  831, 204 },
+  {  7523,  5760,  4893,  5835,  106, 5500, 2049, 2062,  218,  821, 204 },
+  {  7662,  5865,  4980,  5870,  106, 5500, 1882, 1887,  209,  808, 204 },
+  {  7770,  5949,  5053,  5899,  106, 5500, 1766, 1764,  207,  796, 204 },
+  {  7849,  6019,  5118,  5903,  106, 5500, 1700, 1691,  211,  782, 204 },
+  {  7909,  6072,  5168,  5902,  106, 5500, 1683, 1678,  212,  773, 204 },
+  {  7949,  6117,  5216,  5883,  106, 5500, 1703, 1693,  221,  774, 204 },
+  {  7974,  6147,  5248,  5859,  106, 5500, 1734, 1726,  225,  781, 204 },
+  {  7978,  6167,  5276,  5830,  106, 5500, 1736, 1727,  226,  772, 204 },
+  {  8017,  6212,  5324,  5710,  106, 5500, 1912, 1914,  231,  817, 204 },
+  {  8031,  6217,  5324,  5710,  106, 5500, 1903, 1904,  231,  816, 204 },
+  {  8033,  6216,  5322,  5708,  106, 5500, 1937, 1934,  239,  819, 204 },
+  {  8047,  6218,  5318,  5707,  106, 5500, 1930, 1933,  233,  817, 204 },
+  {  8057,  6218,  5313,  5707,  106, 5500, 1920, 1922,  232,  820, 204 },
+  {  8061,  6219,  5313,  5697,  106, 5500, 1931, 1932,  235,  820, 204 },
+  {  8065,  6219,  5311,  5696,  106, 5500, 1924, 1926,  233,  817, 204 },
+  {  8075,  6216,  5301,  5696,  106, 5500, 1915, 1916,  232,  823, 204 },
+  {  8078,  6216,  5299,  5698,  106, 5500, 1902, 1904,  230,  821, 204 },
+  {  8089,  6217,  5295,  5698,  106, 5500, 1893, 1894,  230,  821, 204 },
+  {  7939,  6101,  5197,  5571,  105, 5500, 1808, 1813,  225,  805, 204 },
+  {  7939,  6101,  5197,  5565,  106, 5500, 1817, 1816,  228,  809, 204 },
+  {  7939,  6101,  5197,  5560,  106, 5500, 1824, 1826,  227,  809, 204 },
+  {  7939,  6099,  5194,  5558,  106, 4000, 2350, 2174,  421,    0,   0 },
+  {  7939,  6096,  5189,  5549,  131, 4000, 2350, 2377,  277,    0,   0 },
+  {  7939,  6095,  5188,  5541,  130, 4000,    0, 2177,    0,    0, 231 },
+  {  7910,  6074,  5171,  5538,  117, 4000,    0, 1599,    0,    0, 231 },
+};
+#define SESSION_LENGTH  (sizeof(SESSION) / sizeof(SESSION[0]))
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// helpers
+static void put16(byte *frame, int offset, uint16_t value) {
+  frame[offset]   = value & 0xFF;       // lsb first, as the boiler does
+  frame[offset+1] = (value >> 8) & 0xFF;
+}
+
+static void put32(byte *frame, int offset, uint32_t value) {
+  put16(frame, offset,   value & 0xFFFF);
+  put16(frame, offset+2, value >> 16);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+BoilerSimulator::BoilerSimulator(uint16_t latency, uint16_t jitter, uint32_t seed)
+: _latency(latency), _jitter(jitter), _seed(seed ? seed : 1), _byte_time(1042),
+  _length(0), _pos(0), _start(0), _ended(0), _sample(0), _gas_cv(54028399), _gas_hw(806253), stuck(-1), stuck_value(0),
+  observer(NULL), fuzz(0), corrupted(0)
+{
+  memset(answered, 0, sizeof(answered));
+}
+
+bool BoilerSimulator::begin(int baudrate, int rx_buffer)
+{
+  _byte_time = 10000000UL / baudrate;   // 10 bits per byte (8N1)
+  return true;
+}
+
+// xorshift, so a replay is deterministic for a given seed
+uint32_t BoilerSimulator::_random()
+{
+  _seed ^= _seed << 13;
+  _seed ^= _seed >> 17;
+  _seed ^= _seed << 5;
+  return _seed;
+}
+
+bool BoilerSimulator::print(const char*s)
+{
+  if (observer)
+    observer(s, int32_t(micros() - _ended));
+  _length = 0;                          // a new command discards any unread bytes
+  _pos = 0;
+  memset(_frame, 0, sizeof(_frame));
+
+  if (strcmp(s, "S?\r") == 0)
+    _status_1();
+  else if (strcmp(s, "S2\r") == 0)
+    _status_2();
+  else if (strcmp(s, "HN\r") == 0)
+    _statistics();
+  else if (strcmp(s, "B?\r") == 0)
+    _info(0);
+  else if (strcmp(s, "V?\r") == 0)
+    _info(1);
+  else if (strcmp(s, "V1\r") == 0)
+    _info(2);
+  else
+    return true;                        // unknown commands remain unanswered
+
+  if (fuzz && _random() % 100 < fuzz)
+    _corrupt();
+
+  int32_t delay_ms = _latency;
+  if (_jitter)
+    delay_ms += int32_t(_random() % (2 * _jitter + 1)) - _jitter;
+  if (delay_ms < 0)
+    delay_ms = 0;
+
+  _start = micros() + delay_ms * 1000 + strlen(s) * _byte_time;
+  _ended = _start + (_length - 1) * _byte_time;
+  return true;
+}
+
+int BoilerSimulator::available()
+{
+  int32_t elapsed = int32_t(micros() - _start);
+  if (elapsed < 0 || _pos >= _length)
+    return 0;
+
+  uint32_t arrived = elapsed / _byte_time + 1;
+  if (arrived > _length)
+    arrived = _length;
+  return arrived - _pos;
+}
+
+int BoilerSimulator::read()
+{
+  if (available() <= 0)
+    return -1;
+  return _frame[_pos++];
+}
+
+int BoilerSimulator::readBytes(byte *buffer, int length)
+{
+  int lg = available();
+  if (lg > length)
+    lg = length;
+  if (lg <= 0)
+    return 0;
+  memcpy(buffer, _frame + _pos, lg);
+  _pos += lg;
+  return lg;
+}
+
+int BoilerSimulator::discard()
+{
+  int dropped = available();
+  if (dropped > 0)
+    _pos += dropped;
+  return dropped > 0 ? dropped : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// S? steps through the recorded sessions, S2 and HN answer for the current sample
+////////////////////////////////////////////////////////////////////////////////////////////
+void BoilerSimulator::_status_1()
+{
+  Recording s;
+  _sample = (_sample + 1) % SESSION_LENGTH;
+  memcpy_P(&s, &SESSION[_sample], sizeof(s));
+
+  put16(_frame,  0, s.T_boiler);
+  put16(_frame,  2, s.T_boiler_out);
+  put16(_frame,  4, s.T_boiler_in);
+  put16(_frame,  6, s.T_ww_out);
+  put16(_frame,  8, -5081);             // T_ww_in, not connected
+  put16(_frame, 10, -5081);             // T_outside, not connected
+  put16(_frame, 12, s.pressure);
+  put16(_frame, 14, s.T_set);
+  put16(_frame, 16, s.fan_set);
+  put16(_frame, 18, s.fan_cur);
+  put16(_frame, 20, s.fan_pwm);
+  put16(_frame, 22, s.io_curr);
+  _frame[24] = s.bstate;
+
+  bool burning = s.io_curr > 0;
+  _frame[26] = (s.bstate == 204 ? 1 << 6 : 0)      // tap_switch
+             | (s.fan_set > 0   ? 1 << 4 : 0);     // pump
+  _frame[28] = (burning ? (1 << 7) | (1 << 5) : 0) // gasvalve, io_signal
+             | (1 << 2);                           // pressure_sensor
+  if (stuck >= 0)
+    put16(_frame, stuck, stuck_value);
+  answered[0]++;
+
+  // advance the gas counters, roughly 1 count per second per 3 uA io current
+  if (s.bstate == 204)
+    _gas_hw += s.io_curr / 300;
+  else
+    _gas_cv += s.io_curr / 300;
+
+  _length = 32;
+}
+
+void BoilerSimulator::_status_2()
+{
+  Recording s;
+  memcpy_P(&s, &SESSION[_sample], sizeof(s));
+
+  put16(_frame, 0, s.bstate == 204 ? 178 : 0);      // tapflow in 1/100 l/m
+  _frame[2] = s.fan_set > 0 ? 100 : 200;           // pump pwm
+  put16(_frame,  6, 2050);                         // room set zone 1
+  put16(_frame,  8, 1944);                         // room current zone 1
+  put16(_frame, 12, 2050);                         // room set zone 2
+  put16(_frame, 14, 1944);                         // room current zone 2
+  put16(_frame, 16, -1);                           // outside, always 0xFFFF
+  answered[1]++;
+  _length = 32;
+}
+
+void BoilerSimulator::_statistics()
+{
+  put16(_frame,  0, 30214);                        // line power connected
+  put16(_frame,  8, 41235);                        // burnerstarts
+  put16(_frame, 10, 12);                           // ignition failed
+  put16(_frame, 12, 3);                            // flame lost
+  put32(_frame, 16, _gas_cv);
+  put32(_frame, 20, _gas_hw);
+  put16(_frame, 24, 61234);                        // watermeter
+  answered[2]++;
+  _length = 32;
+}
+
+// static data with the layout of a HRE 24/18, see INFO_FIELDS in HAIntergas.cpp
+void BoilerSimulator::_info(int frame)
+{
+  switch (frame) {
+  case 0:
+    put16(_frame, 0, 2418);                        // product code
+    _frame[2] = 12;                                // version
+    break;
+  case 1:
+    _frame[6] = 80;                                // max flow temperature
+    break;
+  default:
+    _frame[0] = 60;                                // hot water temperature
+    put16(_frame, 2, 1400);                        // fan min
+    put16(_frame, 4, 4600);                        // fan max
+    break;
+  }
+  _length = 32;
+}
+
+void BoilerSimulator::_corrupt()
+{
+  corrupted++;
+  switch (_random() % 3) {
+  case 0:                                          // truncated
+    _length = _random() % _length;
+    break;
+  case 1:                                          // a few bits flipped
+    for (int i = 1 + _random() % 4; i > 0; i--)
+      _frame[_random() % _length] ^= 1 << (_random() % 8);
+    break;
+  default:                                         // garbage
+    for (int i=0; i<_length; i++)
+      _frame[i] = _random();
+    break;
+  }
+}
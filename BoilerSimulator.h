@@ -0,0 +1,59 @@
+/*
+ * A fake Intergas boiler, replaying the sessions recorded in Protocol.txt
+ *
+ * It answers the S?, S2 and HN commands with byte frames as the boiler would do, using a
+ * configurable latency and jitter, and delivering the bytes at the pace of the baudrate.
+ * The jitter is taken from a seeded generator, so each run replays exactly the same way.
+ *
+ * This allows the whole poll/decode/publish path to be tested and timed on a Wemos which is
+ * not connected to the boiler. Enable it by defining SIMULATE_BOILER in Intergas2MQTT.ino
+ *
+ * With fuzz set, that percentage of the responses is truncated, has bits flipped or is replaced
+ * by random bytes, to check the link and the decoders on responses the boiler should never send.
+ */
+#ifndef BOILER_SIMULATOR
+#define BOILER_SIMULATOR
+
+#include <Arduino.h>
+#include "BoilerPort.h"
+
+class BoilerSimulator : public BoilerPort
+{
+private:
+  uint16_t  _latency;       // ms before the first byte is send
+  uint16_t  _jitter;        // ms added or substracted randomly to the latency
+  uint32_t  _seed;
+  uint32_t  _byte_time;     // us needed to transfer one byte at the configured baudrate
+  byte      _frame[32];
+  uint8_t   _length;        // length of the current response
+  uint8_t   _pos;           // bytes already read from the current response
+  uint32_t  _start;         // us timestamp when the first byte arrives
+  uint32_t  _ended;         // us timestamp when the last byte of the previous response arrived
+  uint16_t  _sample;        // current sample in the recorded sessions
+  uint32_t  _gas_cv;        // gas counters, increasing while replaying
+  uint32_t  _gas_hw;
+
+  uint32_t _random();
+  void _status_1();
+  void _status_2();
+  void _statistics();
+  void _info(int frame);
+  void _corrupt();
+public:
+  int8_t    stuck;          // offset of a S? value which reads stuck_value, -1 to replay as recorded
+  int16_t   stuck_value;
+  uint32_t  answered[3];    // S?, S2 and HN responses
+  void    (*observer)(const char *command, int32_t idle);   // each command, with the us since the previous response
+  uint8_t   fuzz;           // percentage of the responses to corrupt, 0 to replay them as recorded
+  uint32_t  corrupted;      // responses corrupted so far
+
+  BoilerSimulator(uint16_t latency = 40, uint16_t jitter = 10, uint32_t seed = 1);
+  bool begin(int baudrate, int rx_buffer = 256);
+  bool print(const char*s);
+  int available();
+  int read();
+  int readBytes(byte *buffer, int length);
+  int discard();
+};
+
+#endif
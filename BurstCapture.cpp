@@ -0,0 +1,108 @@
+#include "BurstCapture.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+BurstCapture::BurstCapture(uint32_t w, uint32_t g)
+: _head(0), _count(0), _unsent(0), _triggered(0), _unix(0), _until(0), _ended(0), _flushed(0), _sequence(0), _reason(0), 
+  _last(0), _active(false), _clock(NULL), window(w), gap(g), bursts(0), skipped(0), dropped(0)
+{
+}
+
+void BurstCapture::begin(uint32_t (*clock)())
+{
+  _clock = clock;
+}
+
+void BurstCapture::add(const byte *frame, int length)
+{
+  if (_count == BURST_FRAMES) {     // make room by dropping the oldest
+    if (_unsent == BURST_FRAMES) {
+      _unsent--;
+      dropped++;
+    }
+    _head = (_head + 1) % BURST_FRAMES;
+    _count--;
+  }
+  Frame &f = _ring[(_head + _count) % BURST_FRAMES];
+  f.time = millis();
+  f.length = length < BURST_FRAME ? length : BURST_FRAME;
+  memcpy(f.data, frame, f.length);
+  _count++;
+  if (active())
+    _unsent++;
+}
+
+bool BurstCapture::trigger(uint8_t reason)
+{
+  bool edge = reason && reason != _last;
+  _last = reason;
+  if (!edge || active())
+    return false;                   // the running burst is not extended, so it ends
+  uint32_t now = millis();
+  if (bursts && now - _ended < gap) {
+    skipped++;
+    return false;
+  }
+  _until = now + window;
+  _active = true;
+  _triggered = now;
+  _unix = _clock ? _clock() : 0;
+  _reason = reason;
+  _sequence = 0;
+  _unsent = _count;                 // the pre-trigger frames
+  bursts++;
+  return true;
+}
+
+bool BurstCapture::active()
+{
+  if (_active && int32_t(millis() - _until) >= 0) {
+    _active = false;
+    _ended = _until;
+  }
+  return _active;
+}
+
+static int put(byte *buffer, int pos, uint32_t value, int bytes)
+{
+  for (int i=0; i<bytes; i++)
+    buffer[pos++] = value >> (8 * i);
+  return pos;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// post when a message is full, or the frames are waiting for a second, or the burst has ended
+////////////////////////////////////////////////////////////////////////////////////////////
+bool BurstCapture::flush(bool (*post)(const byte *data, uint16_t length))
+{
+  if (_unsent == 0)
+    return false;
+
+  const int record = 5 + BURST_FRAME;
+  const int header = 10;
+  bool full = header + _unsent * record > BURST_MESSAGE;
+  if (!full && active() && millis() - _flushed < 1000)
+    return false;
+
+  int pos = 0;
+  _message[pos++] = 'I';
+  _message[pos++] = 'B';
+  _message[pos++] = BURST_VERSION;
+  _message[pos++] = _reason;
+  pos = put(_message, pos, _unix, 4);
+  pos = put(_message, pos, _sequence, 2);
+
+  while (_unsent && pos + record <= BURST_MESSAGE)
+  {
+    Frame &f = _ring[(_head + _count - _unsent) % BURST_FRAMES];
+    pos = put(_message, pos, f.time - _triggered, 4);    // negative for pre-trigger frames
+    _message[pos++] = f.length;
+    memcpy(_message + pos, f.data, f.length);
+    pos += f.length;
+    _unsent--;
+  }
+  _sequence++;
+  _flushed = millis();
+  return post(_message, pos);
+}
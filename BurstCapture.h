@@ -0,0 +1,63 @@
+/*
+ * Burst capture of the raw S? responses around a state transition
+ *
+ * The last frames are always kept in a ring. When triggered, the frames in the ring (pre-trigger)
+ * and all frames received during the window are streamed in compact binary messages. A burst
+ * starts when the reason changes, so a condition which persists only starts one, and not within
+ * the gap after the previous burst:
+ *
+ *   header:  'I' 'B' <version> <reason> <unix time of the trigger, u32> <message sequence, u16>
+ *   frames:  <ms relative to the trigger, s32> <length, u8> <length bytes as received>
+ *
+ * All multibyte values are lsb first, like the boiler does.
+ */
+#ifndef BURST_CAPTURE
+#define BURST_CAPTURE
+
+#include <Arduino.h>
+
+#define BURST_FRAMES      32      // frames in the ring, the pre-trigger frames and those not yet posted
+#define BURST_FRAME       32      // max length of a frame, the length of a S? response
+#define BURST_MESSAGE     512     // max size of a posted message
+#define BURST_VERSION     1
+
+class BurstCapture
+{
+private:
+  struct Frame {
+    uint32_t  time;       // ms timestamp
+    uint8_t   length;
+    byte      data[BURST_FRAME];
+  };
+  Frame     _ring[BURST_FRAMES];
+  uint8_t   _head;        // oldest frame
+  uint8_t   _count;
+  uint8_t   _unsent;      // the newest frames which still need to be posted
+  uint32_t  _triggered;   // ms timestamp of the trigger
+  uint32_t  _unix;        // unix time of the trigger
+  uint32_t  _until;       // ms timestamp the window ends
+  uint32_t  _ended;       // ms timestamp the last burst ended
+  uint32_t  _flushed;     // ms timestamp of the last post
+  uint16_t  _sequence;
+  uint8_t   _reason;
+  uint8_t   _last;        // reason of the previous frame, a burst starts when it changes
+  bool      _active;
+  byte      _message[BURST_MESSAGE];
+  uint32_t (*_clock)();
+
+public:
+  uint32_t  window;       // ms to capture after the trigger, a burst is never extended
+  uint32_t  gap;          // ms after a burst before the next may start
+  uint32_t  bursts;       // times triggered
+  uint32_t  skipped;      // triggers within the gap
+  uint32_t  dropped;      // frames lost as they could not be posted in time
+
+  BurstCapture(uint32_t window = 20000, uint32_t gap = 60000);
+  void begin(uint32_t (*clock)());                    // clock returns the unix time for the header
+  void add(const byte *frame, int length);            // each S? response
+  bool trigger(uint8_t reason);                       // the reason of each S? response, 0 for none, true when a burst starts
+  bool active();                                      // within the window, poll S? back-to-back
+  bool flush(bool (*post)(const byte *data, uint16_t length));   // posts at most one message
+};
+
+#endif
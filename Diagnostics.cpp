@@ -0,0 +1,136 @@
+#include "Diagnostics.h"
+#include <HAMqtt.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////
+#define CONSTRUCT_DIAG(var)                     var(#var, HABaseDeviceType::PrecisionP0)
+#define CONFIGURE_DIAG(var, name, class, unit)  var.setName(name); var.setDeviceClass(class); var.setIcon("mdi:speedometer"); \
+                                                var.setUnitOfMeasurement(unit); var.setEntityCategory("diagnostic"); var.setMaxAge(0)
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+HADiagnostics::HADiagnostics()
+: _since(0), _connected(0), _publishes(0), _waiting(false), _posted(0), commands(0), serial_errors(0), boot_to_sample(0), connect_to_sample(0),
+  CONSTRUCT_DIAG(rtt_status_1), CONSTRUCT_DIAG(rtt_status_2), CONSTRUCT_DIAG(rtt_statistics),
+  CONSTRUCT_DIAG(decode_time),  CONSTRUCT_DIAG(publish_time), CONSTRUCT_DIAG(loop_period), CONSTRUCT_DIAG(ds_conversion),
+  CONSTRUCT_DIAG(free_heap),    CONSTRUCT_DIAG(max_free_block), CONSTRUCT_DIAG(mqtt_publishes), CONSTRUCT_DIAG(mqtt_failures),
+  command_rate("command_rate", HABaseDeviceType::PrecisionP2), posts_per_frame("posts_per_frame", HABaseDeviceType::PrecisionP2),
+  CONSTRUCT_DIAG(serial_errors_total),
+  CONSTRUCT_DIAG(first_sample_boot), CONSTRUCT_DIAG(first_sample_connect)
+{
+  CONFIGURE_DIAG(rtt_status_1,   "rtt S?",         "duration", "ms");
+  CONFIGURE_DIAG(rtt_status_2,   "rtt S2",         "duration", "ms");
+  CONFIGURE_DIAG(rtt_statistics, "rtt HN",         "duration", "ms");
+  CONFIGURE_DIAG(decode_time,    "decode time",    NULL,       "µs");
+  CONFIGURE_DIAG(publish_time,   "publish time",   NULL,       "µs");
+  CONFIGURE_DIAG(loop_period,    "loop period",    NULL,       "µs");
+  CONFIGURE_DIAG(ds_conversion,  "ds conversion",  "duration", "ms");
+  CONFIGURE_DIAG(free_heap,      "free heap",      "data_size","B");
+  CONFIGURE_DIAG(max_free_block, "max free block", "data_size","B");
+  CONFIGURE_DIAG(mqtt_publishes, "mqtt publishes", NULL,       NULL);
+  CONFIGURE_DIAG(mqtt_failures,  "mqtt failures",  NULL,       NULL);
+  CONFIGURE_DIAG(command_rate,   "command rate",   NULL,       "1/s");
+  CONFIGURE_DIAG(posts_per_frame, "posts per frame", NULL,      NULL);
+  CONFIGURE_DIAG(serial_errors_total, "serial errors", NULL,    NULL);
+  CONFIGURE_DIAG(first_sample_boot,    "boot to first sample",    "duration", "ms");
+  CONFIGURE_DIAG(first_sample_connect, "connect to first sample", "duration", "ms");
+
+  rtt_status_1.enableAttributes();
+  rtt_status_2.enableAttributes();
+  rtt_statistics.enableAttributes();
+  decode_time.enableAttributes();
+  publish_time.enableAttributes();
+  loop_period.enableAttributes();
+  ds_conversion.enableAttributes();
+}
+
+void HADiagnostics::begin(HAMqtt *mqtt)
+{
+  mqtt->addDeviceType(&rtt_status_1);
+  mqtt->addDeviceType(&rtt_status_2);
+  mqtt->addDeviceType(&rtt_statistics);
+  mqtt->addDeviceType(&decode_time);
+  mqtt->addDeviceType(&publish_time);
+  mqtt->addDeviceType(&loop_period);
+  mqtt->addDeviceType(&ds_conversion);
+  mqtt->addDeviceType(&free_heap);
+  mqtt->addDeviceType(&max_free_block);
+  mqtt->addDeviceType(&mqtt_publishes);
+  mqtt->addDeviceType(&mqtt_failures);
+  mqtt->addDeviceType(&command_rate);
+  mqtt->addDeviceType(&posts_per_frame);
+  mqtt->addDeviceType(&serial_errors_total);
+  mqtt->addDeviceType(&first_sample_boot);
+  mqtt->addDeviceType(&first_sample_connect);
+}
+
+void HADiagnostics::connected()
+{
+  _connected = millis();
+  _publishes = HAIntergasSensor::publishes;
+  _waiting = true;
+}
+
+bool HADiagnostics::sampled()
+{
+  if (!_waiting || HAIntergasSensor::publishes == _publishes)
+    return false;
+  _waiting = false;
+  uint32_t now = millis();
+  connect_to_sample = now - _connected;
+  if (boot_to_sample == 0)
+    boot_to_sample = now;
+  return true;
+}
+
+void HADiagnostics::_post(HAIntergasSensor &sensor, const PerfStat &stat)
+{
+  char json[96];
+  if (stat.count() == 0)
+    return;
+  sensor.setCount(stat.avg());
+  stat.toJson(json, sizeof(json));
+  sensor.setAttributes(json);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// the loop jitter shows as the spread between min, p95 and max of the loop period
+////////////////////////////////////////////////////////////////////////////////////////////
+void HADiagnostics::publish_all()
+{
+  if (!HAMqtt::instance()->isConnected())
+    return;                     // keep collecting, no use storing these for later
+
+  uint32_t posted = HAIntergasSensor::publishes - _posted;   // before posting the diagnostics themselves
+  if (commands)
+    posts_per_frame.set(float(posted) / commands, 0.0f, 1000.0f);
+  _post(rtt_status_1,   rtt[0]);
+  _post(rtt_status_2,   rtt[1]);
+  _post(rtt_statistics, rtt[2]);
+  _post(decode_time,    decode);
+  _post(publish_time,   publish);
+  _post(loop_period,    loop);
+  _post(ds_conversion,  conversion);
+  free_heap.setCount(ESP.getFreeHeap());
+  max_free_block.setCount(ESP.getMaxFreeBlockSize());
+  mqtt_publishes.setCount(HAIntergasSensor::publishes);
+  mqtt_failures.setCount(HAIntergasSensor::failures);
+  serial_errors_total.setCount(serial_errors);
+  if (boot_to_sample)
+    first_sample_boot.setCount(boot_to_sample);
+  if (connect_to_sample)
+    first_sample_connect.setCount(connect_to_sample);
+  uint32_t now = millis();
+  if (now - _since > 0)
+    command_rate.set(commands * 1000.0f / (now - _since), 0.0f, 1000.0f);
+  commands = 0;
+  _since = now;
+  _posted = HAIntergasSensor::publishes;
+
+  for (int i=0; i<DIAGNOSTICS_RTT; i++)
+    rtt[i].reset();
+  decode.reset();
+  publish.reset();
+  loop.reset();
+  conversion.reset();
+}
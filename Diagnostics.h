@@ -0,0 +1,60 @@
+/*
+ * Performance of the firmware itself, posted as diagnostic sensors of the Intergas device
+ *
+ * The timings are collected in PerfStat's by the main loop. Each period publish() posts
+ * the average as the sensor value, with min, max and p95 as json attributes, and starts over.
+ */
+#ifndef HA_DIAGNOSTICS
+#define HA_DIAGNOSTICS
+
+#include "HAIntergas.h"
+#include "PerfStat.h"
+
+#define DIAGNOSTICS_RTT   3     // round trip stats, one per polled command
+#define DIAGNOSTICS_COUNT 20    // sensors, with some slack
+
+class HADiagnostics
+{
+private:
+  uint32_t          _since;                 // ms timestamp the stats were last reset
+  uint32_t          _connected;             // ms timestamp of the last (re)connect
+  uint32_t          _publishes;             // values posted at the last (re)connect
+  bool              _waiting;               // for the first value posted after the (re)connect
+  uint32_t          _posted;                // values posted at the last publish_all()
+  void _post(HAIntergasSensor &sensor, const PerfStat &stat);
+public:
+  PerfStat          rtt[DIAGNOSTICS_RTT];   // ms from sending a command until the response has been received
+  PerfStat          decode;                 // us to decode a response, including posting the values
+  PerfStat          publish;                // us to post the batched json document
+  PerfStat          loop;                   // us between two calls of loop()
+  PerfStat          conversion;             // ms to convert and read all DS18B20 probes
+  uint32_t          commands;               // responses received from the boiler
+  uint32_t          serial_errors;          // incomplete responses and UART errors, since boot
+  uint32_t          boot_to_sample;         // ms from boot until the first value was posted
+  uint32_t          connect_to_sample;      // ms from the last (re)connect until the first value was posted
+
+  HAIntergasSensor  rtt_status_1;
+  HAIntergasSensor  rtt_status_2;
+  HAIntergasSensor  rtt_statistics;
+  HAIntergasSensor  decode_time;
+  HAIntergasSensor  publish_time;
+  HAIntergasSensor  loop_period;
+  HAIntergasSensor  ds_conversion;
+  HAIntergasSensor  free_heap;
+  HAIntergasSensor  max_free_block;
+  HAIntergasSensor  mqtt_publishes;
+  HAIntergasSensor  mqtt_failures;
+  HAIntergasSensor  command_rate;           // sustained commands per second the boiler responded to
+  HAIntergasSensor  posts_per_frame;        // values posted per response, what the deadbands and windows save
+  HAIntergasSensor  serial_errors_total;
+  HAIntergasSensor  first_sample_boot;
+  HAIntergasSensor  first_sample_connect;
+
+  HADiagnostics();
+  void begin(HAMqtt *mqtt);
+  void publish_all();                       // post and reset the stats
+  void connected();                         // to be called on each (re)connect to the broker
+  bool sampled();                           // to be called from loop, true when the first value after the (re)connect was posted
+};
+
+#endif
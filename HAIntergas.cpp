@@ -4,7 +4,6 @@
 
 #include "HAIntergas.h"
 #include <HAMqtt.h>
-#include <String.h>
 #include <DatedVersion.h>
 DATED_VERSION(1, 0)
 
@@ -14,6 +13,15 @@ DATED_VERSION(1, 0)
 #define GAS_FLOW  38.7    // gasflow in ml/sec (cm3/sec)
 #define GAS_WATT  1361    // gasflow watt (1cm3 = 35.17 Joule)
 #define GAS_USAGE_CALIBRATED  11527.78
+// calibrated per march 6, 2023, used until calibrated with calibrate() which keeps it in flash
+#define GAS_PER_100M3         1161927   // counter increments per 100 m3, a factor of 11619.27 per m3
+#define GAS_CV_COUNTS         54028399  // counters at the reference point
+#define GAS_CV_BASE           468680    // meters at the reference point, in 1/100 m3
+#define GAS_HW_COUNTS         806253
+#define GAS_HW_BASE           6994
+#define GAS_KJ_M3             35170     // energy content of the gas, 35.17 MJ/m3
+#define GAS_MAX_GAP           30000     // ms between S? reads above which nothing is integrated
+#define INFO_INTERVAL         7200000   // ms between reads of B?, V? and V1, so each is read every 6 hours
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -27,46 +35,162 @@ const char *HAIntergas::STATISTICS= "HN\r";
 ////////////////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////////////////
-bool HATempSensor::begin(DallasTemperature *interface, int idx) {
-  return interface->getAddress(address, idx);
+bool HATempSensor::begin(DallasTemperature *interface, const byte addr[8]) {
+  memcpy(address, addr, sizeof(address));
+  return interface->setResolution(address, resolution);   // fails when the probe does not respond
 }
 
 bool HATempSensor::loop(DallasTemperature *interface) {
-  float temp = interface->getTempC(address);
-  if (temp < -5 || temp > 100)
-    return false;
- 
-  return setValue(temp);
+  return set(interface->getTempC(address), -5.0f, 100.0f);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
-#define CONSTRUCT_P0(var)       var(#var, HABaseDeviceType::PrecisionP0)
-#define CONSTRUCT_P2(var)       var(#var, HABaseDeviceType::PrecisionP2)
+#define CONSTRUCT_P0(var)       var(_id(#var), HABaseDeviceType::PrecisionP0)
+#define CONSTRUCT_P2(var)       var(_id(#var), HABaseDeviceType::PrecisionP2)
+#define CONSTRUCT_P3(var)       var(_id(#var), HABaseDeviceType::PrecisionP3)
+#define CONSTRUCT_BIN(var)      var(_id(#var))
 
-#define CONFIGURE_BASE(var, name, class, icon)  var.setName(name); var.setDeviceClass(class); var.setIcon("mdi:" icon)
+#define CONFIGURE_BASE(var, name, class, icon)  var.setName(_label(name)); var.setDeviceClass(class); var.setIcon("mdi:" icon)
 #define CONFIGURE(var, name, class, icon, unit) CONFIGURE_BASE(var, name, class, icon); var.setUnitOfMeasurement(unit)
 #define CONFIGURE_TEMP(var, name, icon)         CONFIGURE(var, name, "temperature", icon, "°C")
-#define CONFIGURE_DS(var, icon)                 CONFIGURE_TEMP(var, #var, icon)
+#define CONFIGURE_COUNTER(var, name, icon)      CONFIGURE_BASE(var, name, NULL, icon); var.setStateClass("total_increasing")
+#define CONFIGURE_HOURS(var, name)              CONFIGURE(var, name, "duration", "timer-outline", "h"); var.setStateClass("total_increasing")
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Response layouts
+// IDS-log: t1,t2,t3,t4,t5,t6,temp_set,fan_set,fanspeed,fan_pwm,opentherm,roomtherm,tap_switch,gp_switch,pump,dwk,gasvalve,io_signal,spark,io_curr,displ_code,ch_pressure
+// XTREME:  https://github.com/little-chef/intergas-xtreme-monitor/blob/main/esphome/IntergasXtremeMonitor.h
+// HRE:     https://github.com/RichieB2B/intergas-exporter/blob/main/intergas-exporter.py
+////////////////////////////////////////////////////////////////////////////////////////////
+// All values are kept as integers in the units of the precision of the sensor, value = (raw * mul) / div + bias
+// Min and max are in natural units, and converted to those of the precision
+#define BASE(value, p)                                    int32_t((value) * (p))
+#define NUMBER(var, type, offset, mul, div, bias, min, max, p)  { HAIntergas::Field::type, offset, 0, mul, div, bias, BASE(min, p), BASE(max, p), &HAIntergas::var, nullptr }
+#define TEMP(var, offset, min, max)                       NUMBER(var, S16, offset, 1, 1, 0, min, max, 100)
+#define COUNTER(var, offset, ext, mul, div, max, p)       { HAIntergas::Field::U24, offset, ext, mul, div, 0, 0, BASE(max, p), &HAIntergas::var, nullptr }
+#define METER(var, offset, max)                           { HAIntergas::Field::U32, offset, 0, 0, 1, 0, 0, BASE(max, 100), &HAIntergas::var, nullptr }   // decoded in _statistics()
+#define FLAG(var, offset, bit)                            { HAIntergas::Field::BIT, offset, bit, 0, 1, 0, 0, 1, nullptr, &HAIntergas::var }
+#define FIELDS(table)                                     table, sizeof(table) / sizeof(table[0])
+
+static constexpr HAIntergas::Field STATUS_1_FIELDS[] PROGMEM = {
+  TEMP(  T_boiler,      0, 10.0f, 100.0f),
+  TEMP(  T_boiler_out,  2, 20.0f,  70.0f),
+  TEMP(  T_boiler_in,   4, 15.0f,  70.0f),
+  TEMP(  T_ww_out,      6, 20.0f,  70.0f),
+//TEMP(  T_ww_in,       8, ...)                                         // NC, always -50.81
+//TEMP(  T_outside,    10, ...)                                         // NC, always -50.81
+  NUMBER(pressure, S16, 12, 1,  1, 0, 0.0f,    5.0f, 100),
+  TEMP(  T_set,        14, 20.0f,  70.0f),
+  NUMBER(fan_set,  S16, 16, 1,  1, 0, 0.0f, 7000.0f, 1),                 // max speed is 6500rpm for a HRE 36/48, 4600 for 28/24
+  NUMBER(fan_cur,  S16, 18, 1,  1, 0, 0.0f, 7000.0f, 1),
+  NUMBER(fan_pwm,  S16, 20, 10, 1, 0, 0.0f,  100.0f, 100),               // with a minimu setting of 20% we read 17.5
+  NUMBER(power,    S16, 22, GAS_WATT, 1000, 0, 0.0f, 30.0f, 100),        // using the io_current to estimate the gas usage in Watts
+  FLAG(gp_switch,    26, 7),
+  FLAG(tap_switch,   26, 6),
+  FLAG(roomtherm,    26, 5),
+  FLAG(pump,         26, 4),
+  FLAG(dwk,          26, 3),
+  FLAG(alarm,        26, 2),
+//FLAG(ch_cascade_relay, 26, 1),
+  FLAG(opentherm,    26, 0),
+  FLAG(gasvalve,     28, 7),
+  FLAG(spark,        28, 6),
+  FLAG(io_signal,    28, 5),
+//FLAG(ch_ot_disabled, 28, 4),
+  FLAG(low_pressure, 28, 3),
+//FLAG(pressure_sensor, 28, 2),
+  FLAG(burner_block, 28, 1),
+//FLAG(grad_flag,    28, 0),
+};
+
+static constexpr HAIntergas::Field STATUS_2_FIELDS[] PROGMEM = {
+  NUMBER(tap_flow,   S16, 0, 1,   1, 0,     0.0f,  20.0f, 100),
+  NUMBER(pump_pwm,   U8,  2, -50, 1, 10000, 0.0f, 100.0f, 100),          // (200 - raw) / 2, expecting max 100%
+//T_z1_override                 5
+  TEMP(  T_room_set,         6, 10.0f, 30.0f),                            // requested room temperature zone 1
+  TEMP(  T_room_cur,         8, 10.0f, 40.0f),                            // current room temperature zone 1
+//T_z2_override                10
+//T_z2_set                     12                                         // requested room temperature zone 2
+//T_z2_cur                     14                                         // current room temperature
+//outside                      16                                         // override_outside_temp?     always 327.67 (0xFFFF = signed -1)
+//OT_master_member_id           3
+//OT_therm_prod_version        18
+//OT_therm_prod_type           19
+};
+
+static constexpr HAIntergas::Field STATISTICS_FIELDS[] PROGMEM = {
+  COUNTER(hours_on,          0, 30, 1, 1, 500000.0f, 1),
+  NUMBER( power_cycles, U16, 2, 1, 1, 0, 0.0f, 65535.0f, 1),
+  NUMBER( hours_ch,     U16, 4, 1, 1, 0, 0.0f, 65535.0f, 1),
+  NUMBER( hours_hw,     U16, 6, 1, 1, 0, 0.0f, 65535.0f, 1),
+  COUNTER(burner_starts,     8, 31, 1, 1, 16777215.0f, 1),
+  NUMBER( ignition_failed, U16, 10, 1, 1, 0, 0.0f, 65535.0f, 1),
+  NUMBER( flame_lost,   U16, 12, 1, 1, 0, 0.0f, 65535.0f, 1),
+  NUMBER( resets,       U16, 14, 1, 1, 0, 0.0f, 65535.0f, 1),
+  METER(  energy_cv,        16, 15000.0f),                                // heating is currently at 5375 m3
+  METER(  energy_hw,        20,  1000.0f),                                // water is currently at 70 m3
+  COUNTER(water_total,      24, 28, 1, 10, 50000.0f, 1000),                 // raw in 0.1 liter
+  COUNTER(burner_starts_hw, 26, 29, 1, 1, 16777215.0f, 1),
+};
+
+// The static data, the raw frames are posted as attributes as well. The offsets have not been
+// verified against a boiler, so the values are information only and never used for validation
+static const HAIntergas::InfoField INFO_FIELDS[HAIntergas::INFO_COUNT] = {
+  { "product",  0, HAIntergas::Field::U16, 0 },   // B?
+  { "version",  0, HAIntergas::Field::U8,  2 },
+  { "ch_max",   1, HAIntergas::Field::U8,  6 },   // V?, the installer parameters in menu order, '5.' is the max flow temperature
+  { "hw_max",   2, HAIntergas::Field::U8,  0 },   // V1
+  { "fan_min",  2, HAIntergas::Field::U16, 2 },
+  { "fan_max",  2, HAIntergas::Field::U16, 4 },
+};
+static const char *INFO_FRAMES[] = { "B?", "V?", "V1" };
+
+static const HAIntergas::Probe PROBES[INTERGAS_DS_COUNT] = {
+  // boiler
+  { &HAIntergas::water_in,  "water_in",   "mdi:thermometer-low" },
+  { &HAIntergas::water_out, "water_out",  "mdi:thermometer-high" },
+  { &HAIntergas::air_in,    "air_in",     "mdi:home-thermometer-outline" },
+  { &HAIntergas::air_out,   "air_out",    "mdi:snowflake-thermometer" },
+  { &HAIntergas::mixed,     "mixed",      "mdi:water-thermometer" },
+  // environment
+  { &HAIntergas::exhaust,   "exhaust",    "mdi:thermometer" },
+  { &HAIntergas::cv_out,    "CV-out",     "mdi:water-thermometer-outline" },
+  { &HAIntergas::cv_in,     "CV-in",      "mdi:water-thermometer" },
+};
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////////////////
-HAIntergas::HAIntergas(int wire_pin)
-: mode("mode"), alarm("alarm"), CONSTRUCT_P0(fault_code), CONSTRUCT_P0(last_fault),
+uint8_t HAIntergas::_instances = 0;
+
+HAIntergas::HAIntergas(int wire_pin, const char *prefix)
+: _prefix(prefix), _slot(_instances++), mode(_id("mode")), alarm(_id("alarm")), CONSTRUCT_BIN(burner_block), CONSTRUCT_BIN(low_pressure), CONSTRUCT_P0(fault_code), CONSTRUCT_P0(last_fault),
   CONSTRUCT_P2(T_boiler),     CONSTRUCT_P2(T_boiler_in),    CONSTRUCT_P2(T_boiler_out),   CONSTRUCT_P2(T_ww_out),  CONSTRUCT_P2(T_set),        
   CONSTRUCT_P2(pressure),     CONSTRUCT_P0(fan_set),    CONSTRUCT_P0(fan_cur),    CONSTRUCT_P2(fan_pwm),   CONSTRUCT_P2(pump_pwm),  CONSTRUCT_P2(tap_flow),
-  CONSTRUCT_P2(T_room_set),   CONSTRUCT_P2(T_room_cur), 
-  CONSTRUCT_P2(power),        CONSTRUCT_P2(energy_cv),   CONSTRUCT_P2(energy_hw),   
+  CONSTRUCT_BIN(pump),        CONSTRUCT_BIN(tap_switch),    CONSTRUCT_BIN(gp_switch),     CONSTRUCT_BIN(dwk),
+  CONSTRUCT_BIN(gasvalve),    CONSTRUCT_BIN(spark),         CONSTRUCT_BIN(io_signal),
+  CONSTRUCT_P2(T_room_set),   CONSTRUCT_P2(T_room_cur),     CONSTRUCT_BIN(roomtherm),     CONSTRUCT_BIN(opentherm),
+  CONSTRUCT_P2(power),        CONSTRUCT_P2(energy_cv),   CONSTRUCT_P2(energy_hw),   CONSTRUCT_P3(water_total),
+  // statistics
+  CONSTRUCT_P0(hours_on),     CONSTRUCT_P0(hours_ch),       CONSTRUCT_P0(hours_hw),       CONSTRUCT_P0(power_cycles),
+  CONSTRUCT_P0(burner_starts),CONSTRUCT_P0(burner_starts_hw), CONSTRUCT_P0(ignition_failed), CONSTRUCT_P0(flame_lost), CONSTRUCT_P0(resets),
+  CONSTRUCT_P0(product),
   // DS sensors
   CONSTRUCT_P2(water_in), CONSTRUCT_P2(water_out), CONSTRUCT_P2(air_in), CONSTRUCT_P2(air_out), 
   CONSTRUCT_P2(mixed), CONSTRUCT_P2(exhaust), CONSTRUCT_P2(cv_out), CONSTRUCT_P2(cv_in),
-  _wire(wire_pin), _sensors(&_wire)
+  _wire(wire_pin), _sensors(&_wire), _probe(INTERGAS_DS_COUNT), _converted(0), _probes_ok(true), _bstate(0),
+  _anchored(false), _raw_cv(0), _raw_hw(0), _gas_cv(0), _gas_hw(0), _anchor_cv(0), _anchor_hw(0), _used_cv(0), _used_hw(0),
+  _kw(0), _kw_state(UNKNOWN), _sampled(0), 
+  _next_frame(0), _info_reads(0), _info_pending(false), _pending(false),
+  state(UNKNOWN), logmsg("")
 {
   //generic
   CONFIGURE_BASE(mode,       "mode",       "enum",     "state-machine"); 
   CONFIGURE_BASE(alarm,      "alarm",      "enum",     "alarm-light"); 
   CONFIGURE_BASE(fault_code, "fault",      "enum",     "code-tags"); 
   CONFIGURE_BASE(last_fault, "last_code",  "enum",     "code-tags"); 
+  CONFIGURE_BASE(burner_block, "lock",     NULL,       "lock"); 
+  CONFIGURE_BASE(low_pressure, "low_pressure", "problem", "gauge-low"); 
   // base temps
   CONFIGURE_TEMP(T_boiler,    "heater",     "gas-burner");
   CONFIGURE_TEMP(T_boiler_in, "heater-in",  "gas-burner");
@@ -80,92 +204,218 @@ HAIntergas::HAIntergas(int wire_pin)
   CONFIGURE(    fan_pwm,      "fan-pwm",    "power_factor",   "fan",        "%"); 
   CONFIGURE(    pump_pwm,     "pump",       "power_factor",   "shower",     "%"); 
   CONFIGURE(    tap_flow,     "tapflow",    "water",          "shower",     "l/m"); 
+  CONFIGURE_BASE(pump,        "pump_on",    "running",        "pump");
+  CONFIGURE_BASE(tap_switch,  "tap_switch", "running",        "water-pump");
+  CONFIGURE_BASE(gp_switch,   "gp_switch",  "running",        "electric-switch");
+  CONFIGURE_BASE(dwk,         "3-way-valve","running",        "valve");
+  CONFIGURE_BASE(gasvalve,    "gasvalve",   "opening",        "valve");
+  CONFIGURE_BASE(spark,       "ignition",   "running",        "flash");
+  CONFIGURE_BASE(io_signal,   "flame",      "heat",           "fire");
   // energy usage
   CONFIGURE(    power,        "power",      "power",          "meter-gas",  "kW"); 
   CONFIGURE(    energy_cv,    "energy_cv",  "gas",            "meter-gas",  "m³"); 
   CONFIGURE(    energy_hw,    "energy_hw",  "gas",            "meter-gas",  "m³");
+  CONFIGURE(    water_total,  "water_total","water",          "water",      "m³");
   energy_cv.setStateClass("total_increasing");
   energy_hw.setStateClass("total_increasing");
+  water_total.setStateClass("total_increasing");
+
+  // statistics
+  CONFIGURE_HOURS(  hours_on,         "hours_on");
+  CONFIGURE_HOURS(  hours_ch,         "hours_ch");
+  CONFIGURE_HOURS(  hours_hw,         "hours_hw");
+  CONFIGURE_COUNTER(power_cycles,     "power_cycles",     "power-plug-off");
+  CONFIGURE_COUNTER(burner_starts,    "burner_starts",    "fire");
+  CONFIGURE_COUNTER(burner_starts_hw, "burner_starts_hw", "fire");
+  CONFIGURE_COUNTER(ignition_failed,  "ignition_failed",  "fire-alert");
+  CONFIGURE_COUNTER(flame_lost,       "flame_lost",       "fire-off");
+  CONFIGURE_COUNTER(resets,           "resets",           "restart-alert");
+  // static data
+  CONFIGURE_BASE(product,     "product",           NULL,           "information-outline");
+  product.setEntityCategory("diagnostic");
+  product.enableAttributes();
+  product.setMaxAge(0);           // posted when read, the config is retained
+  memset(_frames, 0, sizeof(_frames));
+  calibration = { GAS_CV_COUNTS, GAS_HW_COUNTS, GAS_PER_100M3, GAS_CV_BASE, GAS_HW_BASE, 0 };
+  for (int i=0; i<INFO_COUNT; i++)
+    info[i] = -1;
 
   // thermostat
   CONFIGURE_TEMP(T_room_set,  "room_set", "thermostat");
   CONFIGURE_TEMP(T_room_cur,  "room_cur", "home-thermometer");
+  CONFIGURE_BASE(roomtherm,   "room_heat_request", "heat",  "thermostat");
+  CONFIGURE_BASE(opentherm,   "opentherm",         "connectivity", "thermostat");
 
   // DS sensors
-  CONFIGURE_DS(water_in,  "thermometer-low");
-  CONFIGURE_DS(water_out, "thermometer-high");
-  CONFIGURE_DS(mixed,     "water-thermometer");
-  CONFIGURE_DS(air_in,    "home-thermometer-outline");
-  CONFIGURE_DS(air_out,   "snowflake-thermometer");
-  CONFIGURE_DS(exhaust,   "thermometer");
-  CONFIGURE_TEMP(cv_out,  "CV-out", "water-thermometer-outline");
-  CONFIGURE_TEMP(cv_in,   "CV-in","water-thermometer");
+  for (int i=0; i<INTERGAS_DS_COUNT; i++)
+  {
+    HATempSensor &probe = this->*PROBES[i].sensor;
+    probe.setName(_label(PROBES[i].name));
+    probe.setDeviceClass("temperature");
+    probe.setIcon(PROBES[i].icon);
+    probe.setUnitOfMeasurement("°C");
+    probe.setDeadband(0.1f);
+    probe.setWindow(INTERGAS_WINDOW);
+  }
+
+  // only post changes that matter, the max age (default 5 min) keeps them alive in HA
+  T_boiler.setDeadband(0.1f);
+  T_boiler_in.setDeadband(0.1f);
+  T_boiler_out.setDeadband(0.1f);
+  T_ww_out.setDeadband(0.1f);
+  T_room_cur.setDeadband(0.05f);
+  pressure.setDeadband(0.02f);
+  fan_set.setDeadband(25.0f);
+  fan_cur.setDeadband(25.0f, 0.02f);
+  fan_pwm.setDeadband(0.5f);
+  pump_pwm.setDeadband(1.0f);
+  tap_flow.setDeadband(0.05f);
+  power.setDeadband(0.1f, 0.02f);
+  energy_cv.setMonotonic();       // posted by both HN and the integration, which may be ahead of HN
+  energy_hw.setMonotonic();
+
+  // these change by the second during a burn cycle, post the mean with the peaks as attributes.
+  // The raw values remain available in the burst captures
+  T_boiler.setWindow(INTERGAS_WINDOW);
+  T_boiler_in.setWindow(INTERGAS_WINDOW);
+  T_boiler_out.setWindow(INTERGAS_WINDOW);
+  pressure.setWindow(INTERGAS_WINDOW);
+  fan_cur.setWindow(INTERGAS_WINDOW);
+  power.setWindow(INTERGAS_WINDOW);
+}
+
+// a second boiler gets its own ids, as all sensors end up in the same HA device
+const char *HAIntergas::_id(const char *id)
+{
+  if (!_prefix)
+    return id;
+  char *prefixed = (char *) malloc(strlen(_prefix) + strlen(id) + 2);   // once, at startup
+  sprintf(prefixed, "%s_%s", _prefix, id);
+  return prefixed;
+}
+
+const char *HAIntergas::_label(const char *name)
+{
+  if (!_prefix)
+    return name;
+  char *prefixed = (char *) malloc(strlen(_prefix) + strlen(name) + 2);
+  sprintf(prefixed, "%s %s", _prefix, name);
+  return prefixed;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////////////////
-bool HAIntergas::begin(const byte mac[6], HAMqtt *mqtt) 
+bool HAIntergas::begin(const byte mac[6], HAMqtt *mqtt, bool batched) 
 {
-  logmsg.clear();
+  logmsg = "";
   setUniqueId(mac, 6);
   setManufacturer("InnoVeer");
   setName("Intergas HRE24/18");
   setSoftwareVersion(VERSION);
   setModel("Intergas Logger esp8266");
+  Persist::load(PERSIST_CALIBRATION + _slot * (sizeof(Calibration) + 2), &calibration, sizeof(calibration));  // else the defaults
 
   // generic heater
   mqtt->addDeviceType(&mode);     // register the sensors
   mqtt->addDeviceType(&fault_code);
   mqtt->addDeviceType(&last_fault);
-  mqtt->addDeviceType(&alarm);
-  // base temperatures
-  mqtt->addDeviceType(&T_boiler); 
-  mqtt->addDeviceType(&T_boiler_out); 
-  mqtt->addDeviceType(&T_boiler_in); 
-  mqtt->addDeviceType(&T_ww_out); 
-  mqtt->addDeviceType(&T_set); 
-  // speed and pressure
-  mqtt->addDeviceType(&pressure);
-  mqtt->addDeviceType(&fan_set);
-  mqtt->addDeviceType(&fan_cur); 
-  mqtt->addDeviceType(&fan_pwm); 
-  mqtt->addDeviceType(&pump_pwm); 
-  mqtt->addDeviceType(&tap_flow); 
-  // usage
-  mqtt->addDeviceType(&power);
-  mqtt->addDeviceType(&energy_cv);
-  mqtt->addDeviceType(&energy_hw);
-  // thermostate
-  mqtt->addDeviceType(&T_room_set); 
-  mqtt->addDeviceType(&T_room_cur); 
+  mqtt->addDeviceType(&product);
+  // all values decoded from the boiler responses
+  _register(FIELDS(STATUS_1_FIELDS), mqtt);
+  _register(FIELDS(STATUS_2_FIELDS), mqtt);
+  _register(FIELDS(STATISTICS_FIELDS), mqtt);
+  _state_topic[0] = 0;
+  if (batched)
+  {
+    strcpy(_state_topic, mqtt->getDataPrefix());
+    strcat(_state_topic, "/");
+    strcat(_state_topic, getUniqueId());
+    strcat(_state_topic, "/");
+    strcat(_state_topic, _id("state"));
+    _batched(FIELDS(STATUS_1_FIELDS));
+    _batched(FIELDS(STATUS_2_FIELDS));
+    _batched(FIELDS(STATISTICS_FIELDS));
+  }
 
-  // boiler
-  mqtt->addDeviceType(&water_in);  
-  mqtt->addDeviceType(&water_out);  
-  mqtt->addDeviceType(&air_in);  
-  mqtt->addDeviceType(&air_out);  
-  mqtt->addDeviceType(&mixed);  
-  // environment
-  mqtt->addDeviceType(&exhaust);  
-  mqtt->addDeviceType(&cv_out);  
-  mqtt->addDeviceType(&cv_in);  
+  for (int i=0; i<INTERGAS_DS_COUNT; i++)
+    mqtt->addDeviceType(&(this->*PROBES[i].sensor));
+
+  _sensors.setWaitForConversion(false);   // requestTemperatures() returns immediately, results are collected in sensors_loop()
+  return _map_probes();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// The probes are identified by their address, as stored in flash. When all of them respond
+// the bus search is skipped. Otherwise the bus is searched, known probes keep their role and
+// new probes take the roles of those missing, in the order of the bus enumeration.
+////////////////////////////////////////////////////////////////////////////////////////////
+bool HAIntergas::_map_probes()
+{
+  DeviceAddress map[INTERGAS_DS_COUNT];
+  int  record = PERSIST_PROBES + _slot * (sizeof(map) + 2);
+  bool stored = Persist::load(record, map, sizeof(map));
+  _found[0] = 0;
+
+  if (stored)
+  {
+    bool result = true;
+    uint8_t bits = 9;
+    for (int i=0; i<INTERGAS_DS_COUNT && result; i++) {
+      HATempSensor &probe = this->*PROBES[i].sensor;
+      result = probe.begin(&_sensors, map[i]);
+      bits = max(bits, probe.getResolution());
+    }
+    if (result) {
+      _sensors.setResolution(bits);   // without the bus search the conversion time is not known
+      return true;
+    }
+  }
+  else
+    memset(map, 0, sizeof(map));
 
+  // search the bus
   _sensors.begin();
-  if (_sensors.getDeviceCount() < 8)
-    logmsg = "ERROR: We have not found the 8 DS sensors";
+  DeviceAddress bus[INTERGAS_DS_COUNT + 4];
+  int count = min((int) _sensors.getDeviceCount(), INTERGAS_DS_COUNT + 4);
+  bool assigned[INTERGAS_DS_COUNT] = {false};
+  bool known[INTERGAS_DS_COUNT + 4] = {false};
+  bool readable[INTERGAS_DS_COUNT + 4] = {false};
+  for (int j=0; j<count; j++)
+  {
+    readable[j] = _sensors.getAddress(bus[j], j);
+    if (!readable[j]) {
+      memset(bus[j], 0, sizeof(DeviceAddress));   // never assigned, nor stored
+      continue;
+    }
+    for (int i=0; i<INTERGAS_DS_COUNT && stored; i++)
+      if (!assigned[i] && memcmp(bus[j], map[i], sizeof(DeviceAddress)) == 0)
+        assigned[i] = known[j] = true;
+  }
+  // new probes take the first role without a probe
+  for (int j=0, i=0; j<count; j++)
+  {
+    if (known[j] || !readable[j])
+      continue;
+    while (i < INTERGAS_DS_COUNT && assigned[i])
+      i++;
+    if (i == INTERGAS_DS_COUNT)
+      break;
+    memcpy(map[i], bus[j], sizeof(DeviceAddress));
+    assigned[i] = true;
+    int lg = strlen(_found);
+    snprintf(_found + lg, sizeof(_found) - lg, "%s%s", lg ? ", " : "New DS probes: ", PROBES[i].name);
+  }
 
   bool result = true;
-  result &= water_in.begin(&_sensors, 0);
-  result &= water_out.begin(&_sensors, 1);
-  result &= air_in.begin(&_sensors, 2);
-  result &= air_out.begin(&_sensors, 3);
-  result &= mixed.begin(&_sensors, 4);
-  result &= exhaust.begin(&_sensors, 5);
-  result &= cv_out.begin(&_sensors, 6);
-  result &= cv_in.begin(&_sensors, 7);
+  for (int i=0; i<INTERGAS_DS_COUNT; i++)
+    result &= assigned[i] && (this->*PROBES[i].sensor).begin(&_sensors, map[i]);
 
-  if (!result)
+  if (!Persist::save(record, map, sizeof(map)))
+    logmsg = "ERROR: Could not store the DS addresses";
+  if (count < INTERGAS_DS_COUNT)
+    logmsg = "ERROR: We have not found the 8 DS sensors";
+  else if (!result)
     logmsg = "ERROR: One of the sensors did not give its address";
 
   return result;
@@ -176,115 +426,476 @@ bool HAIntergas::begin(const byte mac[6], HAMqtt *mqtt)
 ////////////////////////////////////////////////////////////////////////////////////////////
 bool HAIntergas::status(const byte *buffer, int lg, const char *instruction)
 {
-  logmsg.clear();
+  logmsg = "";
+  if (!buffer || lg <= 0) {
+    logmsg = "ERROR: empty response";
+    return false;
+  }
   if (instruction == STATUS_1)
     return _status_1(buffer, lg);
   if (instruction == STATUS_2)
     return _status_2(buffer, lg);
   if (instruction == STATISTICS)
     return _statistics(buffer, lg);
+  if (instruction == PROD_CODE)
+    return _info(buffer, lg, 0);
+  if (instruction == PARAMS)
+    return _info(buffer, lg, 1);
+  if (instruction == SETTINGS)
+    return _info(buffer, lg, 2);
 
   return false;
 }
 
 bool HAIntergas::sensors()
 {
-  logmsg.clear();
-  _sensors.requestTemperatures();   // send command to sensors to measure
+  if (_probe < INTERGAS_DS_COUNT)
+    return false;                   // previous conversion not yet collected
 
-  bool result = true;
-  result &= water_in.loop(&_sensors);       // retrieve temp
-  result &= water_out.loop(&_sensors);  
-  result &= air_in.loop(&_sensors);  
-  result &= air_out.loop(&_sensors);  
-  result &= mixed.loop(&_sensors);  
-  result &= exhaust.loop(&_sensors);  
-  result &= cv_out.loop(&_sensors);  
-  result &= cv_in.loop(&_sensors);  
+  logmsg = "";
+  _sensors.requestTemperatures();   // send command to sensors to measure, does not wait
+  _converted = millis() + _sensors.millisToWaitForConversion(_sensors.getResolution());
+  _probe = 0;
+  _probes_ok = true;
+  return true;
+}
 
-  if (!result)
+// reading a probe takes a few ms on the bus, so we read one probe per call
+int HAIntergas::sensors_loop()
+{
+  if (_probe >= INTERGAS_DS_COUNT || int32_t(millis() - _converted) < 0)
+    return 0;                       // nothing pending or still converting
+
+  _probes_ok &= (this->*PROBES[_probe].sensor).loop(&_sensors);   // retrieve temp
+  if (++_probe < INTERGAS_DS_COUNT)
+    return 0;
+
+  if (!_probes_ok) {
     logmsg = "ERROR: getting/setting one of the temperatures";
-  return result;
+    return -1;
+  }
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Polling intervals in ms, per state. Poll fast what changes during a burn cycle, and
+// slow down when there is no demand. Lock and alarms are polled fast, to see what is going on
+////////////////////////////////////////////////////////////////////////////////////////////
+static const uint32_t INTERVALS[][HAIntergas::POLL_COUNT] = {
+  //  S?      S2      HN      DS     B?/V?/V1
+  {  2000,   5000,  60000,  10000, INFO_INTERVAL },  // UNKNOWN
+  {  5000,  30000, 300000,  30000, INFO_INTERVAL },  // IDLE
+  {  2000,  10000, 300000,  10000, INFO_INTERVAL },  // STANDBY
+  {  2000,  10000, 300000,  10000, INFO_INTERVAL },  // SPINDOWN
+  {  1000,   5000, 120000,   5000, INFO_INTERVAL },  // LOCK
+  {  1000,   5000, 120000,   5000, INFO_INTERVAL },  // HEATING, gas usage is integrated from S? in between HN
+  {  1000,   1000, 120000,   5000, INFO_INTERVAL },  // HOT_WATER, tap flow is in S2
+};
+static const uint32_t SUMMER_IDLE[HAIntergas::POLL_COUNT] = 
+     { 10000, 300000, 900000, 120000, INFO_INTERVAL };  // IDLE in summer, no heating demand expected
+
+uint32_t HAIntergas::interval(poll what, uint8_t month)
+{
+  if (what == POLL_INFO && _info_reads < 9)
+    for (int i=0; i<3; i++)
+      if (!_frames[i].length)
+        return 2000;                // not yet read since boot, give up after 3 rounds
+
+  if (alarm.getCurrentState())
+    return INTERVALS[LOCK][what];
+
+  bool summer = (month >= 5 && month <= 9);
+  if (state == IDLE && summer)
+    return SUMMER_IDLE[what];
+
+  return INTERVALS[state][what];
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 // value Setters with limits for validation
+uint32_t HAIntergasSensor::publishes  = 0;
+uint32_t HAIntergasSensor::suppressed = 0;
+uint32_t HAIntergasSensor::rejected   = 0;
+uint32_t HAIntergasSensor::failures   = 0;
+
+bool HAIntergasSensor::announce = true;
+
+SampleBuffer     *HAIntergasSensor::history = NULL;
+uint8_t           HAIntergasSensor::count   = 0;
+HAIntergasSensor *HAIntergasSensor::registry[INTERGAS_REGISTRY];
+
+void HAIntergasSensor::setBatched(const char *topic, bool *pending)
+{
+  const char *id = uniqueId();
+  _template = (char *) malloc(strlen(id) + 22);   // once, at startup
+  strcpy(_template, "{{ value_json.");
+  strcat(_template, id);
+  strcat(_template, " }}");
+  _state_topic = topic;
+  _pending = pending;
+}
+
+bool HAIntergasSensor::setAttributes(const char *json)
+{
+  if (!_attributes)
+    return false;
+  return publishOnDataTopic(F("json_attr_t"), json, true);
+}
+
+// our own discovery config when batched, pointing to the shared json document, or when diagnostic
+void HAIntergasSensor::buildSerializer()
+{
+  if (!announce)
+    return;                   // no serializer, no config posted
+  if (!_state_topic && !_category && !_attributes) {
+    HASensorNumber::buildSerializer();
+    return;
+  }
+  if (_serializer || !uniqueId())
+    return;
+
+  _serializer = new HASerializer(this, 14);
+  _serializer->set(AHATOFSTR(HANameProperty), getName());
+  _serializer->set(HASerializer::WithUniqueId);
+  _serializer->set(AHATOFSTR(HADeviceClassProperty), _class);
+  _serializer->set(AHATOFSTR(HAStateClassProperty), _state_class);
+  _serializer->set(AHATOFSTR(HAIconProperty), _icon);
+  _serializer->set(AHATOFSTR(HAUnitOfMeasurementProperty), _unit);
+  _serializer->set(F("ent_cat"), _category);
+  if (_state_topic) {
+    _serializer->set(AHATOFSTR(HAStateTopic), _state_topic);
+    _serializer->set(F("val_tpl"), _template);
+  }
+  else
+    _serializer->topic(AHATOFSTR(HAStateTopic));
+  if (_attributes)
+    _serializer->topic(F("json_attr_t"));
+  _serializer->set(HASerializer::WithDevice);
+  _serializer->set(HASerializer::WithAvailability);
+}
+
+// a batched sensor has no state topic of its own, its value goes out with the next document
+void HAIntergasSensor::onMqttConnected()
+{
+  if (!_state_topic) {
+    HASensorNumber::onMqttConnected();
+    return;
+  }
+  HASensor::onMqttConnected();
+  if (getCurrentValue().isSet())
+    *_pending = true;
+}
+
+static uint32_t fnv1a(uint32_t hash, const char *s)
+{
+  if (s)
+    while (*s)
+      hash = (hash ^ (uint8_t) *s++) * 16777619UL;
+  return (hash ^ 0xff) * 16777619UL;    // separator, so "ab","c" differs from "a","bc"
+}
+
+// the configs of the flags and mode are fixed by the firmware, the VERSION in the seed covers those
+uint32_t HAIntergasSensor::discoveryHash(const char *seed)
+{
+  uint32_t hash = fnv1a(2166136261UL, seed);
+  for (int i=0; i<count; i++)
+  {
+    HAIntergasSensor *s = registry[i];
+    hash = fnv1a(hash, s->uniqueId());
+    hash = fnv1a(hash, s->getName());
+    hash = fnv1a(hash, s->_class);
+    hash = fnv1a(hash, s->_state_class);
+    hash = fnv1a(hash, s->_icon);
+    hash = fnv1a(hash, s->_unit);
+    hash = fnv1a(hash, s->_category);
+    hash = fnv1a(hash, s->_state_topic);
+    hash = fnv1a(hash, s->_template);
+    hash = (hash ^ (s->_precision | s->_attributes << 4)) * 16777619UL;
+  }
+  return hash;
+}
+
+static const int32_t PRECISION_FACTOR[] = { 1, 10, 100, 1000 };
+
+void HAIntergasSensor::setDeadband(float absolute, float relative)
+{
+  _deadband = lroundf(absolute * PRECISION_FACTOR[_precision]);
+  _relative = lroundf(relative * 10000);
+}
+
+// post the value when it moved beyond the deadband, or when the last post has become too old
+bool HAIntergasSensor::_publish(int32_t base)
+{
+  HANumeric current = getCurrentValue();
+  int32_t posted = current.getBaseValue();
+  if (_monotonic && current.isSet() && base < posted) {
+    suppressed++;
+    return true;              // the posted total is ahead, wait for it to catch up
+  }
+  bool aged = _max_age && (millis() - _published >= _max_age);
+
+  if (current.isSet() && !aged)
+  {
+    int32_t delta = abs(base - posted);
+    int32_t band = int64_t(abs(posted)) * _relative / 10000;
+    if (band < _deadband)
+      band = _deadband;
+    if (delta <= band) {
+      if (delta > 0)
+        suppressed++;
+      return true;            // nothing worth posting
+    }
+  }
+  HANumeric number;
+  number.setBaseValue(base);
+  number.setPrecision(_precision);
+
+  if (!HAMqtt::instance()->isConnected()) {
+    setCurrentValue(number);  // keep it for when the broker is back
+    _published = millis();
+    if (history)
+      history->push(_index, base);
+    return true;
+  }
+  if (_state_topic) {         // batched, HAIntergas::publish() will post it
+    setCurrentValue(number);
+    _published = millis();
+    publishes++;
+    *_pending = true;
+    return true;
+  }
+  if (!setValue(number, true)) {
+    failures++;
+    return false;
+  }
+  _published = millis();
+  publishes++;
+  return true;
+}
+
+// A window is closed by the first value after it has passed, so it may last up to a poll interval longer
+bool HAIntergasSensor::_aggregate(int32_t base)
+{
+  if (!_window)
+    return _publish(base);
+
+  bool result = true;
+  if (_n && millis() - _opened >= _window)
+    result = _close();
+  if (_n == 0) {
+    _opened = millis();
+    _lo = _hi = base;
+    _sum = 0;
+  }
+  if (base < _lo) _lo = base;
+  if (base > _hi) _hi = base;
+  _last = base;
+  _sum += base;
+  _n++;
+  return result;
+}
+
+bool HAIntergasSensor::_close()
+{
+  int64_t mean = (_sum + (_sum < 0 ? -_n : _n) / 2) / _n;
+  uint16_t n = _n;
+  _n = 0;
+  bool result = _publish(int32_t(mean));
+  if (!HAMqtt::instance()->isConnected())
+    return result;            // the history only keeps the mean
+
+  // in natural units, with the decimals of the precision
+  char json[96], lo[16], hi[16], last[16];
+  HANumeric number;
+  number.setPrecision(_precision);
+  number.setBaseValue(_lo);   lo[number.toStr(lo)] = 0;
+  number.setBaseValue(_hi);   hi[number.toStr(hi)] = 0;
+  number.setBaseValue(_last); last[number.toStr(last)] = 0;
+  snprintf(json, sizeof(json), "{\"min\":%s,\"max\":%s,\"last\":%s,\"n\":%u}", lo, hi, last, n);
+  return setAttributes(json) && result;
+}
+
+bool HAIntergasSensor::setBase(int32_t base, int32_t min, int32_t max)
+{
+  if (base >= min && base <= max)
+    return _aggregate(base);  // value is within expected limits so post the value
+
+  rejected++;               // keep the last valid value, the max age will repost it
+  return false;
+}
+
 bool HAIntergasSensor::set(float value, float min, float max) 
 {
   if (value >= min && value <= max)
-    return setValue(value); // value is within expected limits so post the value
+    return _aggregate(lroundf(value * PRECISION_FACTOR[_precision]));
 
-  setCurrentValue(0.0f);    // set the current value to force a post on the first valid value 
+  rejected++;
   return false;
 }
 
+bool HAIntergasSensor::setCount(uint32_t value)
+{
+  return _publish(value > INT32_MAX ? INT32_MAX : int32_t(value));   // counters and sizes, never negative
+}
+
 bool HAIntergasSensor::set(uint16_t value, uint16_t min, uint16_t max)
 {
   if (value >= min && value <= max)
-    return setValue(value); // value is within expected limits so post the value
+    return _aggregate(int32_t(value) * PRECISION_FACTOR[_precision]);
 
-  setCurrentValue(0);    // set the current value to force a post on the first valid value 
+  rejected++;
   return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
-// helpers
-float getfloat(uint8_t lsb, uint8_t msb) {
-  if (msb > 127)
-    return -(float((msb ^ 255) + 1) * 256 - lsb) / 100.0;
-  //else
-  return float(msb * 256 + lsb) / 100.0;
+// generic decoder, walking a response layout
+////////////////////////////////////////////////////////////////////////////////////////////
+static const uint8_t FIELD_WIDTH[] = { 1, 1, 2, 2, 2, 4 };   // bytes at offset, in the order of Field::Type
+
+// the value at p, msb is the most significant byte of a U24
+static int32_t read_raw(const byte *p, uint8_t type, byte msb)
+{
+  switch (type) {
+  case HAIntergas::Field::BIT:
+  case HAIntergas::Field::U8:   return p[0];
+  case HAIntergas::Field::S16:  return int16_t(p[0] | (p[1] << 8));
+  case HAIntergas::Field::U16:  return uint16_t(p[0] | (p[1] << 8));
+  case HAIntergas::Field::U24:  return p[0] | (p[1] << 8) | (uint32_t(msb) << 16);
+  default:                      return p[0] | (p[1] << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+  }
+}
+
+void HAIntergas::_register(const Field *fields, int count, HAMqtt *mqtt)
+{
+  for (int i=0; i<count; i++)
+  {
+    Field f;
+    memcpy_P(&f, &fields[i], sizeof(f));
+    if (f.type == Field::BIT)
+      mqtt->addDeviceType(&(this->*f.flag));
+    else
+      mqtt->addDeviceType(&(this->*f.number));
+  }
+}
+
+void HAIntergas::_batched(const Field *fields, int count)
+{
+  for (int i=0; i<count; i++)
+  {
+    Field f;
+    memcpy_P(&f, &fields[i], sizeof(f));
+    if (f.type != Field::BIT)
+      (this->*f.number).setBatched(_state_topic, &_pending);
+  }
+}
+
+// append "id":value for each batched value of the layout, returns the new position in the document
+int HAIntergas::_serialize(const Field *fields, int count, int pos)
+{
+  for (int i=0; i<count; i++)
+  {
+    Field f;
+    memcpy_P(&f, &fields[i], sizeof(f));
+    if (f.type == Field::BIT)
+      continue;
+
+    HAIntergasSensor &sensor = this->*f.number;
+    HANumeric value = sensor.getCurrentValue();
+    const char *id = sensor.uniqueId();
+    if (!value.isSet() || pos + strlen(id) + value.calculateSize() + 5 >= sizeof(_batch))
+      continue;
+
+    _batch[pos] = pos ? ',' : '{';
+    pos++;
+    _batch[pos++] = '"';
+    strcpy(_batch + pos, id);
+    pos += strlen(id);
+    _batch[pos++] = '"';
+    _batch[pos++] = ':';
+    pos += value.toStr(_batch + pos);
+  }
+  return pos;
+}
+
+// Only the numbers of the layout tables are batched. The flags and the mode are posted by the library
+// on their own state topics, the DS18B20 probes on their own conversion cycle, so those stay separate
+bool HAIntergas::publish()
+{
+  if (_info_pending && HAMqtt::instance()->isConnected() && !_post_info())
+    return false;
+  if (!_state_topic[0] || !_pending || !HAMqtt::instance()->isConnected())
+    return true;                // when disconnected the values are kept in the history
+
+  int pos = 0;
+  pos = _serialize(FIELDS(STATUS_1_FIELDS), pos);
+  pos = _serialize(FIELDS(STATUS_2_FIELDS), pos);
+  pos = _serialize(FIELDS(STATISTICS_FIELDS), pos);
+  if (pos == 0)
+    return true;
+  _batch[pos++] = '}';
+  _batch[pos] = 0;
+
+  if (!HAMqtt::instance()->publish(_state_topic, _batch, false)) {
+    HAIntergasSensor::failures++;
+    logmsg = "ERROR: posting the json state document";
+    return false;
+  }
+  _pending = false;
+  return true;
+}
+
+bool HAIntergas::_decode(const Field *fields, int count, const byte *sbuf, int lg)
+{
+  bool result = true;
+
+  for (int i=0; i<count; i++)
+  {
+    Field f;
+    memcpy_P(&f, &fields[i], sizeof(f));    // the layouts are kept in flash
+
+    int end = f.offset + FIELD_WIDTH[f.type];
+    if (f.type == Field::U24 && f.ext >= end)
+      end = f.ext + 1;
+    if (end > lg) {                         // response too short for this field
+      result = false;
+      continue;
+    }
+    const byte *p = sbuf + f.offset;
+
+    if (f.type == Field::BIT) {
+      result &= (this->*f.flag).setState(bool(p[0] & (1 << f.ext)));
+      continue;
+    }
+    if (f.mul == 0)
+      continue;                             // decoded elsewhere
+    int32_t raw = read_raw(p, f.type, f.type == Field::U24 ? sbuf[f.ext] : 0);
+    int32_t base;
+    if (f.div == 1)
+      base = raw * f.mul;
+    else {                                  // rounded, in 64 bits as the products may not fit
+      int64_t n = (f.type == Field::U32) ? int64_t(uint32_t(raw)) * f.mul : int64_t(raw) * f.mul;
+      base = (n + (n < 0 ? -f.div : f.div) / 2) / f.div;
+    }
+    result &= (this->*f.number).setBase(base + f.bias, f.min, f.max);
+  }
+  return result;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
-// IDS-log: t1,t2,t3,t4,t5,t6,temp_set,fan_set,fanspeed,fan_pwm,opentherm,roomtherm,tap_switch,gp_switch,pump,dwk,gasvalve,io_signal,spark,io_curr,displ_code,ch_pressure
-// XTREME:  https://github.com/little-chef/intergas-xtreme-monitor/blob/main/esphome/IntergasXtremeMonitor.h
-// HRE:     https://github.com/RichieB2B/intergas-exporter/blob/main/intergas-exporter.py
+//
 ////////////////////////////////////////////////////////////////////////////////////////////
 bool HAIntergas::_status_1(const byte *sbuf, int lg)
 {
-  if (lg<25) {
+  if (lg<30) {
     logmsg = "ERROR: processing S? result -> too short";
     return false;
   }
   LOG("Processing state 1 result\n");
-  bool result = true;
-
-  result &= T_boiler.set(getfloat(sbuf[ 0], sbuf[ 1]), 10.0f, 100.0f);
-  result &= T_boiler_out.set(getfloat(sbuf[ 2], sbuf[ 3]), 20.0f,  70.0f);
-  result &= T_boiler_in.set (getfloat(sbuf[ 4], sbuf[ 5]), 15.0f,  70.0f);
-  result &= T_ww_out.set(getfloat(sbuf[ 6], sbuf[ 7]), 20.0f,  70.0f);
-//result &= T_ww_in.set( getfloat(sbuf[ 8], sbuf[ 9]);                // NC, always -50.81
-//result &= T_outside.set(getfloat(sbuf[10], sbuf[11]);                // NC, always -50.81
-  result &= pressure.set(getfloat(sbuf[12], sbuf[13]),  0.0f,  5.0f);
-  result &= T_set.set(   getfloat(sbuf[14], sbuf[15]), 20.0f, 70.0f);
-  uint16_t fan= getfloat(sbuf[16], sbuf[17]) * 100;                   // target fanspeed, remember the fanspeed for boiler modus
-  result &= fan_set.set( fan,                              0,  7000); // max speed is 6500rpm for a HRE 36/48, 4600 for 28/24 
-  result &= fan_cur.set( getfloat(sbuf[18], sbuf[19])*100, 0,  7000); // current fanspeed
-  result &= fan_pwm.set( getfloat(sbuf[20], sbuf[21]) *10, 0,  100);     // with a minimu setting of 20% we read 17.5 
-  result &= power.set(   getfloat(sbuf[22], sbuf[23]) *GAS_WATT/1000, 0, 30); // using the io_current to estimate the gas usage in Watts
+  bool result = _decode(FIELDS(STATUS_1_FIELDS), sbuf, lg);
 
+  int16_t fan = sbuf[16] | (sbuf[17] << 8);     // target fanspeed, remember the fanspeed for boiler modus
   _bstate = sbuf[24];
 
-/*  data['gp_switch']          = bool(ig_raw[26] &  1 << 7)
-    data['tap_switch']         = bool(ig_raw[26] &  1 << 6)
-    data['roomtherm']          = bool(ig_raw[26] &  1 << 5)
-    data['pump']               = bool(ig_raw[26] &  1 << 4)
-    data['dwk']                = bool(ig_raw[26] &  1 << 3)
-    data['alarm_status']       = bool(ig_raw[26] &  1 << 2)
-    data['ch_cascade_relay']   = bool(ig_raw[26] &  1 << 1)
-    data['opentherm']          = bool(ig_raw[26] &  1 << 0)
-    data['gasvalve']           = bool(ig_raw[28] &  1 << 7)
-    data['spark']              = bool(ig_raw[28] &  1 << 6)
-    data['io_signal']          = bool(ig_raw[28] &  1 << 5)
-    data['ch_ot_disabled']     = bool(ig_raw[28] &  1 << 4)
-    data['low_water_pressure'] = bool(ig_raw[28] &  1 << 3)
-    data['pressure_sensor']    = bool(ig_raw[28] &  1 << 2)
-    data['burner_block']       = bool(ig_raw[28] &  1 << 1)
-    data['grad_flag']          = bool(ig_raw[28] &  1 << 0)
-*/
-  result &= alarm.setState(sbuf[26] & (1 << 2));
-
   if (sbuf[27] == 128)          // and what about the alarm bit?
     result &= fault_code.setValue(sbuf[29]);      // current listed fault code is the active fault code
   else
@@ -322,16 +933,53 @@ bool HAIntergas::_status_1(const byte *sbuf, int lg)
       result = mode.setValue("hot_water");
       state = HOT_WATER;   break;
     default:  
-      result = mode.setValue(("code 0x" + String(_bstate, 16)).c_str());
+      snprintf(_code, sizeof(_code), "code 0x%x", _bstate);
+      result = mode.setValue(_code);
       state = UNKNOWN;    break;
     }
   }
+  int16_t io_curr = sbuf[22] | (sbuf[23] << 8);
+  result &= _integrate(int32_t(io_curr) * GAS_WATT / 1000);
+
   if (!result)
     logmsg = "ERROR: processing return S? command";
 
   return result;  // return the result of posting the boiler mode
 }
 
+// out of range meters saturate, to be rejected by setBase()
+static int32_t saturate(int64_t meter)
+{
+  return meter > INT32_MAX ? INT32_MAX : meter < INT32_MIN ? INT32_MIN : int32_t(meter);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Gas used since the previous S? read, at the power and in the state of that read. Millis
+// are used, as the rtc only has seconds and may be stepped by NTP. The HN read re-anchors
+////////////////////////////////////////////////////////////////////////////////////////////
+bool HAIntergas::_integrate(int32_t kw)
+{
+  bool result = true;
+  uint32_t now = millis();
+  uint32_t dt = now - _sampled;
+
+  if (_anchored && _sampled && dt < GAS_MAX_GAP)
+  {
+    // 1/100 kW * ms = 1/100000 kJ, so 1/100 m3 = 1/100 kW * ms / (1000 * GAS_KJ_M3)
+    if (_kw_state == HOT_WATER) {
+      _used_hw += int64_t(_kw) * dt;
+      result &= energy_hw.setBase(saturate(_anchor_hw + _used_hw / (1000LL * GAS_KJ_M3)), 0, BASE(1000, 100));
+    } else {
+      _used_cv += int64_t(_kw) * dt;
+      result &= energy_cv.setBase(saturate(_anchor_cv + _used_cv / (1000LL * GAS_KJ_M3)), 0, BASE(15000, 100));
+    }
+  }
+  _sampled = now;
+  _kw = (kw >= 0 && kw <= 3000) ? kw : 0;
+  _kw_state = state;
+  return result;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -343,22 +991,8 @@ bool HAIntergas::_status_2(const byte *sbuf, int lg)
   }
   LOG("Processing state 2 result\n");
 
-  bool result = true;
+  bool result = _decode(FIELDS(STATUS_2_FIELDS), sbuf, lg);
 
-  result &= tap_flow.set(getfloat(sbuf[0], sbuf[1]), 0.0f, 20.0f);
-  result &= pump_pwm.set((200 - sbuf[2])/2.0, 0.0f, 100.0f); // expecting max 100%
-  //  T_z1_override = getFloat(sbuf[5], sbuf[4]);
-  result &= T_room_set.set(getfloat(sbuf[6], sbuf[7]), 10.0f, 30.0f);     // requested room temperature zone 1
-  result &= T_room_cur.set(getfloat(sbuf[8], sbuf[9]), 10.0f, 40.0f);     // current room temperature zone 1
-  //  T_z2_override = getFloat(sbuf[11], sbuf[10]);   // ?
-  //  T_z2_set      = getFloat(sbuf[13], sbuf[12]);   // requested room temperature zone 2
-  //  T_z2_cur      = getFloat(sbuf[15], sbuf[14]);   // current room temperature
-  //  outside   = getFloat(sbuf[17], sbuf[16]);   // override_outside_temp?     always 327.67 (0xFFFF = signed -1)
-
-  // data['OT_master_member_id']   = ig_raw[3]
-  // data['OT_therm_prod_version'] = ig_raw[18]
-  // data['OT_therm_prod_type']    = ig_raw[19]  
-  
   if (!result)
     logmsg = "ERROR: processing return S? command";
   return result;
@@ -367,18 +1001,6 @@ bool HAIntergas::_status_2(const byte *sbuf, int lg)
 ////////////////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////////////////
-float gas_used_calibrated(float value, bool cv) {
-
-//  return value / GAS_USAGE_CALIBRATED;
-  float calibrated;
-  if (cv)                                                        // calibrated per march 6, 2023
-    calibrated = (value - 54028399.0f) / 11619.27f + 4686.8f;    // take the statistics of today, apply a (new) factor and add the offset communicated the day before
-  else // hw
-    calibrated = (value - 806253.0f)   / 11619.27f + 69.94f;
-
-  return calibrated;
-}
-
 bool HAIntergas::_statistics(const byte *sbuf, int lg)
 {
   if (lg<24) {
@@ -387,28 +1009,193 @@ bool HAIntergas::_statistics(const byte *sbuf, int lg)
   }
   LOG("Processing statistics result\n");
 
-  bool result = true;
+  bool result = _decode(FIELDS(STATISTICS_FIELDS), sbuf, lg);
 
-  result &= energy_cv.set(gas_used_calibrated(float(sbuf[16] + (sbuf[17] << 8) + (sbuf[18] << 16) + (sbuf[19] << 24)), true), 0.0f, 15000.0f);   // heating is currently at 5375 m3
-  result &= energy_hw.set(gas_used_calibrated(float(sbuf[20] + (sbuf[21] << 8) + (sbuf[22] << 16) + (sbuf[23] << 24)), false), 0.0f,  1000.0f);   // water is currently at 70 m3
-//  result &= water_total.set(float(sbuf[24] + (sbuf[25] << 8) + (sbuf[28] << 16)) / 10000.0f, 0.0f, 50000.0f);
-
-  /*data['line_power_connected']  = Get_int(ig_raw[0], ig_raw[1]) + ig_raw[30] * 65536
-      data['line_power_disconnect'] = Get_int(ig_raw[2], ig_raw[3])
-      data['ch_function']           = Get_int(ig_raw[4], ig_raw[5])
-      data['dhw_function']          = Get_int(ig_raw[6], ig_raw[7])
-      data['burnerstarts']          = Get_int(ig_raw[8], ig_raw[9]) + ig_raw[31] * 65536
-      data['ignition_failed']       = Get_int(ig_raw[10], ig_raw[11])
-      data['flame_lost']            = Get_int(ig_raw[12], ig_raw[13])
-      data['reset']                 = Get_int(ig_raw[14], ig_raw[15])
-      data['gasmeter_cv']           = Get_int32(ig_raw[16:20]) / float(10000)
-      data['gasmeter_dhw']          = Get_int32(ig_raw[20:24]) / float(10000)
-      data['watermeter']            = Get_int32(ig_raw[24:26] + ig_raw[28].to_bytes(2,'little')) / float(10000)
-      data['burnerstarts_dhw']      = Get_int32(ig_raw[26:28] + ig_raw[29].to_bytes(2,'little'))
-*/
+  // the counters are exact, extend them by the deltas so they never wrap, and start integrating from here
+  uint32_t cv = read_raw(sbuf + 16, Field::U32, 0);
+  uint32_t hw = read_raw(sbuf + 20, Field::U32, 0);
+  if (!_anchored) {                       // nearest to the reference, which has the high words of before the reboot
+    _gas_cv = calibration.cv_counts + int32_t(cv - uint32_t(calibration.cv_counts));
+    _gas_hw = calibration.hw_counts + int32_t(hw - uint32_t(calibration.hw_counts));
+  } else {
+    _gas_cv += uint32_t(cv - _raw_cv);    // also when the 32 bits have wrapped
+    _gas_hw += uint32_t(hw - _raw_hw);
+  }
+  _raw_cv = cv;
+  _raw_hw = hw;
+  _anchored = true;
+  _anchor();
+  result &= energy_cv.setBase(_anchor_cv, 0, BASE(15000, 100));
+  result &= energy_hw.setBase(_anchor_hw, 0, BASE(1000, 100));
+
+  if (!result)
+    logmsg = "ERROR: processing return HN command";
   return result;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
+// Static data. Read in turn, quickly until all have been read and then on the slow timer.
+// Only when the checksum of a frame has changed, it is decoded and posted again
 ////////////////////////////////////////////////////////////////////////////////////////////
+static uint16_t crc16(const byte *p, int lg)
+{
+  uint16_t crc = 0xFFFF;            // CRC-16/CCITT
+  while (lg--) {
+    crc ^= uint16_t(*p++) << 8;
+    for (int i=0; i<8; i++)
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
 
+const char *HAIntergas::info_command()
+{
+  static const char **commands[] = { &PROD_CODE, &PARAMS, &SETTINGS };
+  const char *cmd = *commands[_next_frame];
+  _next_frame = (_next_frame + 1) % 3;
+  if (_info_reads < 255)
+    _info_reads++;
+  return cmd;
+}
+
+bool HAIntergas::_info(const byte *sbuf, int lg, int frame)
+{
+  if (lg < 4 || lg > INTERGAS_INFO_FRAME) {
+    logmsg = "ERROR: processing static data, unexpected length";
+    return false;
+  }
+  Frame &f = _frames[frame];
+  uint16_t crc = crc16(sbuf, lg);
+  if (f.length == lg && f.crc == crc)
+    return true;                    // unchanged, nothing to decode
+
+  memcpy(f.data, sbuf, lg);
+  f.length = lg;
+  f.crc = crc;
+  for (int i=0; i<INFO_COUNT; i++)
+  {
+    const InfoField &field = INFO_FIELDS[i];
+    if (field.frame == frame && field.offset + FIELD_WIDTH[field.type] <= lg)
+      info[i] = read_raw(f.data + field.offset, field.type, 0);
+  }
+  _info_pending = true;
+  return true;
+}
+
+bool HAIntergas::_post_info()
+{
+  for (int i=0; i<3; i++)
+    if (!_frames[i].length)
+      return true;                  // wait for all of them
+
+  int pos = snprintf(_batch, sizeof(_batch), "{");
+  for (int i=0; i<INFO_COUNT; i++)
+    pos += snprintf(_batch + pos, sizeof(_batch) - pos, "\"%s\":%d,", INFO_FIELDS[i].name, (int) info[i]);
+  for (int i=0; i<3; i++) {         // the raw frames, for the fields not decoded
+    pos += snprintf(_batch + pos, sizeof(_batch) - pos, "%s\"%s\":\"", i ? "," : "", INFO_FRAMES[i]);
+    for (int j=0; j<_frames[i].length; j++)
+      pos += snprintf(_batch + pos, sizeof(_batch) - pos, "%02x", _frames[i].data[j]);
+    pos += snprintf(_batch + pos, sizeof(_batch) - pos, "\"");
+  }
+  snprintf(_batch + pos, sizeof(_batch) - pos, "}");
+
+  product.set((uint16_t) info[INFO_PRODUCT], 0, 65535);
+  if (!product.setAttributes(_batch)) {
+    HAIntergasSensor::failures++;
+    logmsg = "ERROR: posting the static data";
+    return false;
+  }
+  _info_pending = false;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Gas meters. The 64 bit counters are exact, the meters are derived in 1/100 m3 with integers only
+////////////////////////////////////////////////////////////////////////////////////////////
+int32_t HAIntergas::_meter(uint64_t counter, uint64_t reference, int32_t base)
+{
+  int64_t counts = int64_t(counter - reference);
+  if (counts > (1LL << 40) || counts < -(1LL << 40))
+    return counts < 0 ? INT32_MIN : INT32_MAX;
+  int64_t n = counts * 10000;                             // in 1/100 m3 times per_100m3
+  int64_t d = calibration.per_100m3;
+  return saturate(base + (n + (n < 0 ? -d : d) / 2) / d);
+}
+
+void HAIntergas::_anchor()
+{
+  _anchor_cv = _meter(_gas_cv, calibration.cv_counts, calibration.cv_base);
+  _anchor_hw = _meter(_gas_hw, calibration.hw_counts, calibration.hw_base);
+  _used_cv = _used_hw = 0;
+}
+
+// parses "4686.80" into 468680, for the given number of decimals. At most 9 digits in all,
+// so the result fits in an int32
+static bool parse_fixed(const char *s, int decimals, int32_t &value)
+{
+  const char *end = s;
+  int32_t whole = 0, fraction = 0, scale = 1;
+  for (; *end >= '0' && *end <= '9'; end++) {
+    if (end - s == 9 - decimals)
+      return false;
+    whole = whole * 10 + (*end - '0');
+  }
+  if (end == s)
+    return false;
+  for (int i=0; i<decimals; i++)
+    scale *= 10;
+  if (*end == '.')
+    for (int32_t digit = scale / 10; *++end >= '0' && *end <= '9'; digit /= 10)
+      fraction += (*end - '0') * digit;   // digits beyond the decimals add 0
+  if (*end && *end != ' ' && *end != '\r' && *end != '\n')
+    return false;
+  value = whole * scale + fraction;
+  return true;
+}
+
+bool HAIntergas::calibrate(const char *command)
+{
+  logmsg = "";
+  int32_t value;
+  Calibration c = calibration;
+  if (strncmp(command, "factor ", 7) == 0 && parse_fixed(command + 7, 2, value) && value > 0)
+  {
+    if (_anchored) {                // keep the meters where they are
+      c.cv_counts = _gas_cv;
+      c.cv_base = _anchor_cv;
+      c.hw_counts = _gas_hw;
+      c.hw_base = _anchor_hw;
+    }
+    c.per_100m3 = value;
+  }
+  else if (!_anchored) {
+    logmsg = "ERROR: calibrating without a HN read";
+    return false;
+  }
+  else if (strncmp(command, "cv ", 3) == 0 && parse_fixed(command + 3, 2, value)) {
+    c.cv_counts = _gas_cv;
+    c.cv_base = value;
+  }
+  else if (strncmp(command, "hw ", 3) == 0 && parse_fixed(command + 3, 2, value)) {
+    c.hw_counts = _gas_hw;
+    c.hw_base = value;
+  }
+  else {
+    logmsg = "ERROR: unknown calibration, expecting cv, hw or factor";
+    return false;
+  }
+  calibration = c;
+  if (_anchored) {
+    _anchor();
+    energy_cv.reset();            // a meter set back would be held off as monotonic
+    energy_hw.reset();
+  }
+  if (!Persist::save(PERSIST_CALIBRATION + _slot * (sizeof(Calibration) + 2), &calibration, sizeof(calibration))) {
+    logmsg = "ERROR: Could not store the calibration";
+    return false;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////
@@ -5,30 +5,121 @@
 #include <device-types\HASensorNumber.h>
 #include <device-types\HABinarySensor.h>
 #include <utils\HASerializer.h>
+#include <utils\HADictionary.h>
 #include <DallasTemperature.h>
 #include <OneWire.h>
+#include "SampleBuffer.h"
+#include "Persist.h"
 
-#define INTERGAS_SENSOR_COUNT 30    // its actually 28 but well..... give it some slack
+#define INTERGAS_SENSOR_COUNT 56    // per boiler, its actually 50 but well..... give it some slack
+#define INTERGAS_DS_COUNT     8
+#define INTERGAS_INFO_FRAME   32    // max length of a B?, V? or V1 response
+#ifndef INTERGAS_WINDOW
+#define INTERGAS_WINDOW       30000 // ms over which the fast changing values are aggregated, 0 to post them as read
+#endif
+#ifndef INTERGAS_MAX_BOILERS
+#define INTERGAS_MAX_BOILERS  2     // boilers served by one controller, sizes the sensor registry
+#endif
+#define INTERGAS_REGISTRY     (INTERGAS_SENSOR_COUNT * INTERGAS_MAX_BOILERS + 16)   // plus the diagnostics
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 // Intergas sensors
 class HAIntergasSensor : public HASensorNumber
 {
+private:
+  uint8_t   _precision;
+  uint8_t   _index;         // position in the registry, identifies the sensor in the history
+  bool      _monotonic;     // only increasing values are posted
+  int32_t   _deadband;      // absolute change needed before a new value is posted, in units of the precision
+  uint16_t  _relative;      // change relative to the posted value needed before a new value is posted, in 1/10000
+  uint32_t  _max_age;       // ms after which the value is posted again, even when unchanged
+  uint32_t  _published;     // ms timestamp of the last post
+  // aggregation over a window, the mean is posted as value with min, max and last as attributes
+  uint32_t  _window;        // ms, 0 when each value is posted
+  uint32_t  _opened;        // ms timestamp of the first value in the window
+  uint16_t  _n;             // values in the window
+  int32_t   _lo, _hi, _last;
+  int64_t   _sum;
+  // when batched the value is posted in a json document on a shared state topic
+  const char *_state_topic;
+  bool      *_pending;      // of the owning device, set when a batched value has changed
+  char      *_template;
+  const char *_class, *_state_class, *_icon, *_unit;   // kept to build our own discovery config
+  const char *_category;    // entity category, like "diagnostic"
+  bool      _attributes;    // json attributes are posted with setAttributes()
+
+  bool      _publish(int32_t base);
+  bool      _aggregate(int32_t base);
+  bool      _close();
+protected:
+  virtual void buildSerializer() override;
+  virtual void onMqttConnected() override;
 public:
-  HAIntergasSensor(const char*id, const NumberPrecision p) : HASensorNumber(id, p) {};
+  static uint32_t publishes;  // values posted by all intergas sensors
+  static uint32_t suppressed; // values not posted as they were within the deadband
+  static uint32_t rejected;   // values not posted as they were out of range
+  static uint32_t failures;   // values which could not be posted to mqtt
+  static bool     announce;   // post the discovery configs on connect, false when HA already has them
+  static SampleBuffer *history; // values are stored here while not connected, NULL to drop them
+  static uint8_t  count;      // sensors in the registry
+  static HAIntergasSensor *registry[INTERGAS_REGISTRY];
+
+  HAIntergasSensor(const char*id, const NumberPrecision p) 
+  : HASensorNumber(id, p), _precision(p), _monotonic(false), _deadband(0), _relative(0), _max_age(300000), _published(0),
+    _window(0), _opened(0), _n(0), _lo(0), _hi(0), _last(0), _sum(0),
+    _state_topic(NULL), _pending(NULL), _template(NULL), _class(NULL), _state_class(NULL), _icon(NULL), _unit(NULL),
+    _category(NULL), _attributes(false)
+  {
+    _index = count;
+    if (count < INTERGAS_REGISTRY)
+      registry[count++] = this;
+  };
+  uint8_t   precision() const { return _precision; };
+  void      setDeviceClass(const char *c)       { _class = c;       HASensorNumber::setDeviceClass(c); };
+  void      setStateClass(const char *c)        { _state_class = c; HASensorNumber::setStateClass(c); };
+  void      setIcon(const char *icon)           { _icon = icon;     HASensorNumber::setIcon(icon); };
+  void      setUnitOfMeasurement(const char *u) { _unit = u;        HASensorNumber::setUnitOfMeasurement(u); };
+  void      setEntityCategory(const char *c)    { _category = c; };   // to be called before connecting
+  void      enableAttributes()                  { _attributes = true; };
+  bool      setAttributes(const char *json);  // post the json attributes
+  void      setBatched(const char *topic, bool *pending);  // post to the json document on topic, flagging pending, to be called before connecting
+  bool      isBatched() const { return _state_topic != NULL; };
+  void      setDeadband(float absolute, float relative = 0.0f);
+  void      setMaxAge(uint32_t ms) { _max_age = ms; };                // 0 to only post on changes
+  void      setMonotonic() { _monotonic = true; };                    // for totals which may not go back
+  void      reset() { setCurrentValue(HANumeric()); _n = 0; };         // forget the posted value, so a total may go back once
+  void      setWindow(uint32_t ms) { _window = ms; if (ms) _attributes = true; };  // aggregate over ms, to be called before connecting
   bool      set(float value, float min, float max); // sets a float when value is in between min, max
   bool      set(uint16_t value, uint16_t min, uint16_t max); // sets a word when value is in between min, max
+  bool      setCount(uint32_t value);         // counters and sizes
+  bool      setBase(int32_t base, int32_t min, int32_t max);  // all in units of the precision, no float math
+
+  static uint32_t discoveryHash(const char *seed);   // FNV-1a over the seed and the discovery configs of all sensors
 };
 
+// a device type of the library, which skips its discovery config when HA already has it
+template <class T> class HAQuiet : public T
+{
+protected:
+  virtual void buildSerializer() override { if (HAIntergasSensor::announce) T::buildSerializer(); };
+public:
+  template <typename... Args> HAQuiet(Args... args) : T(args...) {};
+};
+typedef HAQuiet<HABinarySensor> HAIntergasFlag;
+
 ////////////////////////////////////////////////////////////////////////////////////////////
 //
-class HATempSensor : public HASensorNumber
+class HATempSensor : public HAIntergasSensor
 {
 private:
   byte address[8];
+  uint8_t resolution;   // 9..12 bits, a lower resolution converts faster (94ms for 9 bits, 750ms for 12 bits)
 public:
-  HATempSensor(const char*id, const NumberPrecision p) : HASensorNumber(id, p) {};
-  bool begin(DallasTemperature *interface, int idx);
+  HATempSensor(const char*id, const NumberPrecision p) : HAIntergasSensor(id, p), resolution(12) {};
+  void setResolution(uint8_t bits) { resolution = bits; };   // to be called before begin()
+  uint8_t getResolution() const { return resolution; };
+  const byte *getAddress() const { return address; };
+  bool begin(DallasTemperature *interface, const byte addr[8]);
   bool loop(DallasTemperature *interface);
 };
 
@@ -37,13 +128,112 @@ public:
 class HAIntergas : public HADevice 
 {
 private:
+  const char        *_prefix;     // of the sensor ids and names, for the second and further boilers
+  uint8_t            _slot;       // of this boiler in the persisted records
+  static uint8_t     _instances;
   OneWire            _wire;
   DallasTemperature  _sensors;
+  uint8_t            _probe;      // next probe to read, INTERGAS_DS_COUNT when no conversion is pending
+  uint32_t           _converted;  // ms timestamp when the pending conversion is ready
+  bool               _probes_ok;
   uint8_t            _bstate;
+  char               _code[12];   // mode of an unknown boiler state, "code 0x.."
+  char               _found[96];  // roles of the new DS probes, see found()
+  // gas used in between the HN reads, integrated from the power of each S? read
+  bool               _anchored;   // a HN read has been received
+  uint32_t           _raw_cv;     // gas counters of the last HN read, as received
+  uint32_t           _raw_hw;
+  uint64_t           _gas_cv;     // the same, extended to 64 bits by adding the deltas
+  uint64_t           _gas_hw;
+  int32_t            _anchor_cv;  // meter at the last HN read, in 1/100 m3
+  int32_t            _anchor_hw;
+  int64_t            _used_cv;    // integrated since the last HN read, in 1/100 kW * ms
+  int64_t            _used_hw;
+  int32_t            _kw;         // power at the previous S? read, in 1/100 kW
+  uint8_t            _kw_state;   // state at the previous S? read
+  uint32_t           _sampled;    // ms timestamp of the previous S? read
+  // the static data of the boiler, only decoded and posted when a frame has changed
+  struct Frame {
+    byte             data[INTERGAS_INFO_FRAME];
+    uint8_t          length;      // 0 when not yet read
+    uint16_t         crc;
+  }                  _frames[3];  // B?, V? and V1
+  uint8_t            _next_frame; // to be read
+  uint8_t            _info_reads; // since boot
+  bool               _info_pending;   // a frame has changed and the attributes need to be posted
+
+public:
+  // describes where a value is found in a response, and which sensor it is posted to
+  struct Field {
+    enum Type : uint8_t {
+      BIT,      // single bit, ext is the bit number
+      U8,
+      S16,      // lsb first, as are all multibyte values
+      U16,
+      U24,      // 16 bits at offset, with the most significant byte at ext
+      U32,
+    } type;
+    uint8_t offset;
+    uint8_t ext;
+    int32_t mul;        // value = raw * mul / div + bias, in units of the precision of the sensor
+    int32_t div;
+    int32_t bias;
+    int32_t min, max;   // valid range, in units of the precision
+    HAIntergasSensor HAIntergas::*number;
+    HAIntergasFlag   HAIntergas::*flag;
+  };
+  // where a value is found in the static data of the boiler
+  enum info {
+    INFO_PRODUCT,     // product code
+    INFO_VERSION,     // firmware version
+    INFO_CH_MAX,      // max flow temperature for heating, in degrees
+    INFO_HW_MAX,      // hot water temperature, in degrees
+    INFO_FAN_MIN,     // in rpm
+    INFO_FAN_MAX,
+    INFO_COUNT,
+  };
+  struct InfoField {
+    const char  *name;
+    uint8_t      frame;   // 0 for B?, 1 for V? and 2 for V1
+    Field::Type  type;
+    uint8_t      offset;
+  };
+  // the gas meters are derived from the counters of the boiler, meter = base + (counter - reference) / counts per m3
+  struct Calibration {
+    uint64_t cv_counts;   // extended counters at the reference point, their high words survive a reboot
+    uint64_t hw_counts;
+    uint32_t per_100m3;   // counter increments per 100 m3
+    int32_t  cv_base;     // meter at the reference point, in 1/100 m3
+    int32_t  hw_base;
+    uint32_t reserved;    // no padding in the record
+  };
+  // a DS18B20 probe on the OneWire bus, in the order of the bus enumeration
+  struct Probe {
+    HATempSensor HAIntergas::*sensor;
+    const char  *name;
+    const char  *icon;
+  };
 
+private:
+  char               _state_topic[64];  // json document with all batched values
+  char               _batch[1024];
+  bool               _pending;    // a batched value has changed and the json document needs to be posted
+
+  const char *_id(const char *id);
+  const char *_label(const char *name);
+  bool _map_probes();
+  void _register(const Field *fields, int count, HAMqtt *mqtt);
+  void _batched(const Field *fields, int count);
+  int  _serialize(const Field *fields, int count, int pos);
+  bool _decode(const Field *fields, int count, const byte *buffer, int lg);
   bool _status_1(const byte *buffer, int lg);
   bool _status_2(const byte *buffer, int lg);
   bool _statistics(const byte *buffer, int lg);
+  bool _integrate(int32_t kw);
+  int32_t _meter(uint64_t counter, uint64_t reference, int32_t base);
+  void _anchor();
+  bool _info(const byte *buffer, int lg, int frame);
+  bool _post_info();
 public:
   static const char *PROD_CODE;
   static const char *STATUS_1;
@@ -62,11 +252,22 @@ public:
     HOT_WATER,  // hot water
   } state;
 
-  HAIntergas(int wire_pin);
+  enum poll {     // what is to be polled, each at its own interval
+    POLL_STATUS_1,
+    POLL_STATUS_2,
+    POLL_STATISTICS,
+    POLL_SENSORS,
+    POLL_INFO,      // B?, V? and V1 in turn
+    POLL_COUNT,
+  };
+
+  HAIntergas(int wire_pin, const char *prefix = NULL);   // prefix the ids and names of all but the first boiler
 
   // generic heater
-  HASensor          mode;      // will always post to mqtt, also serves as 'alive' message
-  HABinarySensor    alarm;      
+  HAQuiet<HASensor> mode;      // will always post to mqtt, also serves as 'alive' message
+  HAIntergasFlag    alarm;      
+  HAIntergasFlag    burner_block;
+  HAIntergasFlag    low_pressure;
   HAIntergasSensor  fault_code;
   HAIntergasSensor  last_fault;
   // base temperatures
@@ -82,13 +283,37 @@ public:
   HAIntergasSensor  fan_pwm;   // fan PWM duty cycle percentage
   HAIntergasSensor  pump_pwm;  // pump PWM duty cycle percentage
   HAIntergasSensor  tap_flow;
+  HAIntergasFlag    pump;
+  HAIntergasFlag    tap_switch;
+  HAIntergasFlag    gp_switch;
+  HAIntergasFlag    dwk;
+  HAIntergasFlag    gasvalve;
+  HAIntergasFlag    spark;
+  HAIntergasFlag    io_signal;  // flame detected
   // thermostate
   HAIntergasSensor  T_room_set;
   HAIntergasSensor  T_room_cur;
+  HAIntergasFlag    roomtherm;  // on/off thermostat requests heat
+  HAIntergasFlag    opentherm;  // opentherm thermostat connected
   // energy usage
   HAIntergasSensor  power;      // using ionization current (io_curr = flame detection) in uA to calculate the power in kW
   HAIntergasSensor  energy_cv;  // total gas used for heating
   HAIntergasSensor  energy_hw;  // total gas used for hot water
+  HAIntergasSensor  water_total;// total hot water tapped
+  // statistics
+  HAIntergasSensor  hours_on;         // hours connected to the power line
+  HAIntergasSensor  hours_ch;         // hours of central heating
+  HAIntergasSensor  hours_hw;         // hours of hot water
+  HAIntergasSensor  power_cycles;     // times disconnected from the power line
+  HAIntergasSensor  burner_starts;
+  HAIntergasSensor  burner_starts_hw;
+  HAIntergasSensor  ignition_failed;
+  HAIntergasSensor  flame_lost;
+  HAIntergasSensor  resets;
+  // static data
+  HAIntergasSensor  product;          // the product code, with the static data as attributes
+  int32_t           info[INFO_COUNT]; // decoded from B?, V? and V1, -1 until read
+  Calibration       calibration;      // kept in flash, see calibrate()
 
   // boiler
   HATempSensor  water_in;
@@ -102,11 +327,17 @@ public:
   HATempSensor  cv_out;
   HATempSensor  cv_in;
 
-  bool begin(const byte mac[6], HAMqtt *mqqt);
+  bool begin(const byte mac[6], HAMqtt *mqqt, bool batched = false);   // batched posts all decoded values as one json document
+  bool publish();                                                   // post the json document when batched values have changed
   bool status(const byte *buffer, int lg, const char *instruction); // parse the intergas serial response
-  bool sensors();                                                   // read DS1820 sensors
+  bool sensors();                                                   // start a conversion of the DS1820 sensors
+  int  sensors_loop();                                              // collect one DS1820 once converted, returns 1 when all done, -1 on errors
+  uint32_t interval(poll what, uint8_t month);                      // ms between two polls, depending on the boiler state and season
+  const char *info_command();                                       // the static data to be read next, B?, V? or V1, in turn
+  bool calibrate(const char *command);                              // "cv 4686.80" or "hw 69.94" sets the meter at the last HN read, "factor 11619.27" the counts per m3
 
-  String logmsg; 
+  const char *logmsg;       // the last error, empty when none. Always a literal, so nothing gets allocated
+  const char *found() const { return _found; };   // the roles taken by new DS probes at begin(), empty when none
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -1,5 +1,11 @@
 #include "HAIntergas.h"
 #include "WemosSerial.h"
+#include "BoilerLink.h"
+#include "SampleBuffer.h"
+#include "LogQueue.h"
+#include "Diagnostics.h"
+#include "BurstCapture.h"
+#include "MetricsServer.h"
 #include <ESP8266WiFi.h>
 #include <HAMqtt.h>
 #include <LED.h>
@@ -7,9 +13,18 @@
 #include <Clock.h>
 #include <Timer.h>
 #include <DatedVersion.h>
+#include <time.h>
 DATED_VERSION(0, 9)
 #include "secrets.h"
 
+//#define SIMULATE_BOILER                     // replay the sessions from Protocol.txt instead of talking to the boiler
+//#define CHECK_HEAP                          // report when decoding and posting a response changes the free heap
+//#define SIMULATE_FUZZ   5                   // with SIMULATE_BOILER, corrupt 5% of the responses
+//#define FUZZ_DECODER    1000                // at startup, decode 1000 rounds of random buffers of random length
+#ifdef SIMULATE_BOILER
+#include "BoilerSimulator.h"
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////////////////
 // Configuration
 const char* sta_ssid      = STA_SSID;
@@ -19,15 +34,56 @@ const char* mqtt_server   = "192.168.2.170";   // test.mosquitto.org"; //"broker
 int         mqtt_port     = 1883;             // 8883;
 const char* mqtt_user     = MQTT_USER;
 const char *mqtt_passwd   = MQTT_PASS;
+#ifndef MQTT_BATCHED
+#define MQTT_BATCHED  false
+#endif
+const bool  mqtt_batched  = MQTT_BATCHED;     // post all boiler values as one json document per response
+#ifndef PIPELINED
+#define PIPELINED     false
+#endif
+const bool  pipelined     = PIPELINED;        // send S? and S2 back-to-back, instead of at their intervals
+const uint16_t min_gap    = 20;               // ms the boiler gets between a response and the next command, when pipelined or in a burst
+#define NTP_SERVER  "pool.ntp.org"
+#define NTP_TZ      "CET-1CEST,M3.5.0,M10.5.0/3"    // Europe/Amsterdam
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 // Global instances
 LED               led(D1);                    // pin D4 is used for TX so we can not use the onboard LED
 WiFiClient        socket;                     // the client socket used to connect to mqtt
 HAIntergas        ketel(D2);                  // THe intergas boiler HA device with all of its sensors
-HAMqtt            mqtt(socket, ketel, INTERGAS_SENSOR_COUNT);  // Home Assistant MTTQ    we are at 14 sensors, so set to 20
+//HAIntergas      ketel2(D5, "b2");           // a second (cascaded) boiler, with its own OneWire bus
+#define BOILERS   1                           // HAMqtt supports one HA device, the sensors of all boilers are in the first
+HAMqtt            mqtt(socket, ketel, INTERGAS_SENSOR_COUNT * BOILERS + DIAGNOSTICS_COUNT);  // Home Assistant MTTQ
+HADiagnostics     diag;                       // performance of the firmware, posted as diagnostic sensors of the boiler
+#ifdef SIMULATE_BOILER
+BoilerSimulator   wemos_serial(40, 10);       // replay recorded boiler sessions, 40ms latency with 10ms jitter
+#else
 WemosSerial       wemos_serial;               // the special serial used on a WEMOS version ESP8266
+#endif
+BoilerLink        boiler(wemos_serial);       // non-blocking command/response handling with the boiler
+//BoilerSimulator second_serial(40, 10, 2);   // any other BoilerPort for the second boiler
+//BoilerLink      boiler2(second_serial);
 Clock             rtc;                        // A real (software) time clock
+SampleBuffer      history;                    // values taken while the broker could not be reached
+LogQueue          logs(LogQueue::INFO_LEVEL); // remote log lines waiting to be posted
+BurstCapture      burst(20000, 60000);        // raw S? responses around a state transition, 20s after the trigger, a minute apart
+MetricsServer     metrics(80);                // the latest values over http, also when the broker is down
+
+// everything needed to poll one boiler, all boilers share one scheduler
+struct Boiler {
+  HAIntergas     &device;
+  BoilerLink     &link;
+  BoilerPort     &port;
+  BurstCapture   *burst;                      // NULL when not captured
+  Timer           gap;                        // minimal gap between two commands
+  uint32_t        last_polled[HAIntergas::POLL_COUNT];   // ms timestamp of the last poll, per task
+  uint32_t        conversion_start;           // ms timestamp the DS18B20 conversion was started
+};
+
+Boiler boilers[BOILERS] = {
+  { ketel,  boiler,  wemos_serial,  &burst },
+//{ ketel2, boiler2, second_serial, NULL },
+};
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 // For remote logging the log include needs to be after the global MQTT definition
@@ -35,149 +91,473 @@ Clock             rtc;                        // A real (software) time clock
 #define LOG_LEVEL 2
 #include <Logging.h>
 
+// the library does not pass the level to the callback, so the sketch logs through these
+LogQueue::Level log_level = LogQueue::INFO_LEVEL;
+#define LOG_ERROR(...)  do { log_level = LogQueue::ERROR_LEVEL; ERROR(__VA_ARGS__); } while (0)
+#define LOG_INFO(...)   do { log_level = LogQueue::INFO_LEVEL;  INFO(__VA_ARGS__);  } while (0)
+#define LOG_DEBUG(...)  do { log_level = LogQueue::DEBUG_LEVEL; DEBUG(__VA_ARGS__); } while (0)
+
 void LOG_CALLBACK(char *msg) { 
   LOG_REMOVE_NEWLINE(msg);
-  mqtt.publish("Intergas/log", msg, true); 
+  logs.push(msg, log_level);                  // posted from loop(), see flush_log()
+}
+
+bool post_log(const char *msg) {
+  return mqtt.publish("Intergas/log", msg, true);
+}
+
+bool boilers_idle() {
+  for (int b=0; b<BOILERS; b++)
+    if (boilers[b].link.busy())
+      return false;
+  return true;
+}
+
+// only when no boiler is being talked to, and within the rate limit of the queue
+void flush_log() {
+  if (boilers_idle() && mqtt.isConnected())
+    logs.flush(post_log);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
-// Connect to the STA network
-void wifi_connect() 
+// Connect to the STA network. The ESP connects in the background, so we only (re)start it
+// and check back later. Meanwhile the boiler is polled as usual.
+Timer wifi_retry;
+bool  wifi_up = false;
+bool  rtc_synced = false;
+
+bool wifi_connect() 
 { 
-  if (((WiFi.getMode() & WIFI_STA) == WIFI_STA) && WiFi.isConnected())
-    return;
+  if (WiFi.isConnected()) 
+  {
+    if (!wifi_up) {
+      wifi_up = true;
+      LOG_INFO("WiFi connected with IP address: %s\n", WiFi.localIP().toString().c_str());
+      if (!rtc_synced)
+        configTime(NTP_TZ, NTP_SERVER);   // SNTP runs in the background, see sync_rtc()
+    }
+    return true;
+  }
+  if (wifi_up) {
+    wifi_up = false;
+    LOG_ERROR("WiFi connection lost\n");
+  }
+  if (!wifi_retry.passed())
+    return false;
 
-  DEBUG("Wifi connecting to %s.", sta_ssid);
+  LOG_DEBUG("Wifi connecting to %s\n", sta_ssid);
+  WiFi.mode(WIFI_STA);
   WiFi.begin(sta_ssid, sta_pswd);
-  while (WiFi.status() != WL_CONNECTED) {
-    delay(500);
-    DEBUG(".");
-  }
-  DEBUG("\n");
-  INFO("WiFi connected with IP address: %s\n", WiFi.localIP().toString().c_str());
+  wifi_retry.set(30000);              // give it some time before starting over
+  return false;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
-// Time sync
+// Time sync, the clock is set once SNTP has received the time. The boiler is polled
+// and its values posted meanwhile, only the records in the history are not yet on time.
 void sync_rtc() {
-  rtc.ntp_sync();
-  INFO("Clock synchronized to %s\n", rtc.now().timestamp().c_str());
+  if (rtc_synced || !wifi_up)
+    return;
+  time_t t = time(NULL);
+  if (t < 1600000000)
+    return;                           // no answer yet
+  struct tm *tm = localtime(&t);
+  rtc.adjust(DateTime(tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec));
+  rtc_synced = true;
+  LOG_INFO("Clock synchronized to %s\n", rtc.now().timestamp().c_str());
+}
+
+uint32_t unix_time() {
+  return rtc.now().unixtime();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Post the values stored during an outage, oldest first, a few at a time to not flood the broker.
+// Each line reads: <sensor id> <value> <unix time>
+Timer drain_interval;
+
+void drain_history()
+{
+  if (!drain_interval.passed() || !history.count() || !mqtt.isConnected())
+    return;
+  drain_interval.set(200);
+
+  char payload[512];
+  int pos = 0, n = 0;
+  Sample s;
+  for (; n<8 && history.peek(s, n); n++)
+  {
+    if (s.sensor >= HAIntergasSensor::count)
+      continue;
+    HAIntergasSensor *sensor = HAIntergasSensor::registry[s.sensor];
+    uint8_t  p = sensor->precision();
+    int32_t  div = (p == 3) ? 1000 : (p == 2) ? 100 : (p == 1) ? 10 : 1;
+    uint32_t v = labs(s.value);
+    if (p)
+      pos += snprintf(payload + pos, sizeof(payload) - pos, "%s %s%lu.%0*lu %lu\n", sensor->uniqueId(), 
+                      s.value < 0 ? "-" : "", (unsigned long) (v / div), p, (unsigned long) (v % div), (unsigned long) s.time);
+    else
+      pos += snprintf(payload + pos, sizeof(payload) - pos, "%s %ld %lu\n", sensor->uniqueId(), (long) s.value, (unsigned long) s.time);
+  }
+  if (pos == 0) {
+    history.remove(n);                // none of a known sensor
+    return;
+  }
+  payload[pos-1] = 0;                 // strip the last newline
+  if (!mqtt.publish("Intergas/history", payload, false)) {
+    LOG_ERROR("Posting the history failed, %d values kept for a retry\n", n);
+    drain_interval.set(5000);         // give the broker some time
+    return;
+  }
+  history.remove(n);                  // only now they have been posted
+  if (!history.count())
+    LOG_INFO("History posted, %lu values dropped during the outage\n", (unsigned long) history.dropped);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 // MQTT Connect
+uint32_t discovery;                   // hash of the discovery configs, set in setup()
+
+// the discovery configs are retained by the broker, so only post them when they have changed
 void mqtt_connect() {
-  INFO("Intergas Logger v%s saying hello\n", VERSION);
+  LOG_INFO("Intergas Logger v%s saying hello\n", VERSION);
+  uint32_t announced = 0;
+  HAIntergasSensor::announce = !Persist::load(PERSIST_CONFIG, &announced, sizeof(announced)) || announced != discovery;
+  if (!HAIntergasSensor::announce)
+    LOG_INFO("Discovery configs unchanged, not posted\n");
+  mqtt.subscribe("Intergas/calibrate/+");   // the boiler index, payload as "cv 4686.80", "hw 69.94" or "factor 11619.27"
+  diag.connected();
+}
+
+// sets the gas meters of a boiler to the readings of the real meter
+void mqtt_message(const char *topic, const uint8_t *payload, uint16_t length)
+{
+  const char *slash = strrchr(topic, '/');
+  int b = slash ? atoi(slash + 1) : -1;
+  if (strncmp(topic, "Intergas/calibrate/", 19) || b < 0 || b >= BOILERS || !length || strlen(topic) >= 32)
+    return;                                 // an empty payload is our own clear below
+  // topic and payload point into the buffer of the client, which publish() builds its packet in
+  char own[32], command[32];
+  strcpy(own, topic);
+  length = min(length, (uint16_t) (sizeof(command) - 1));
+  memcpy(command, payload, length);
+  command[length] = 0;
+  mqtt.publish(own, "", true);              // clear a retained command, else it is applied again on each connect
+
+  HAIntergas &device = boilers[b].device;
+  if (!device.calibrate(command))
+    LOG_ERROR(device.logmsg);
+  else
+    LOG_INFO("Boiler %d calibrated with %s\n", b, command);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////////////////
-bool retrieve_status(DateTime &now, const char*cmd) 
+struct Command {
+  const char *cmd;
+  uint16_t    timeout;      // ms to wait for the first byte of the response
+  uint8_t     retries;      // times to resend the command when there is no (complete) response
+  uint8_t     length;       // bytes in the response
+};
+
+const Command commands[] = {
+  { HAIntergas::STATUS_1,   300, 1, 32 },
+  { HAIntergas::STATUS_2,   300, 1, 32 },
+  { HAIntergas::STATISTICS, 500, 1, 32 },
+  { HAIntergas::PROD_CODE,  500, 1, 0 },   // the static data, length differs per boiler type
+  { HAIntergas::PARAMS,     500, 1, 0 },
+  { HAIntergas::SETTINGS,   500, 1, 0 },
+};
+
+const Command &command_of(const char *cmd)
 {
-  INFO("[%s] - Sending message to boiler: %s\n", 
-              now.timestamp(DateTime::TIMESTAMP_TIME).c_str(), 
-              cmd);  
-  wemos_serial.print(cmd);
-
-  int i=0;
-  do {
-    delay(200);
-    if (i++>3) {
-      ERROR("No response\n");
-      return false;
-    }
-  } while (!wemos_serial.available());
+  for (unsigned i=0; i<sizeof(commands)/sizeof(commands[0]); i++)
+    if (commands[i].cmd == cmd)
+      return commands[i];
+  return commands[0];
+}
 
-  byte buffer[64];
-  for (i=0; i<sizeof(buffer) && wemos_serial.available(); i++) 
-    buffer[i] = wemos_serial.read();
+// hh:mm:ss in a fixed buffer, DateTime::timestamp() allocates a String
+const char *time_of(DateTime &now)
+{
+  static char buffer[12];
+  snprintf(buffer, sizeof(buffer), "%02d:%02d:%02d", now.hour(), now.minute(), now.second());
+  return buffer;
+}
 
-  INFO("Response from boiler of %d bytes\n", i);  
-  DEBUG_BIN("Response from boiler: ", buffer, i);
+bool retrieve_status(DateTime &now, Boiler &b, const Command &command) 
+{
+  LOG_DEBUG("[%s] - Sending message to boiler %d: %s\n", time_of(now), int(&b - boilers), command.cmd);  
+  return b.link.send(command.cmd, command.timeout, command.retries, command.length);
+}
 
-  if (!ketel.status(buffer, i, cmd)) {
-    ERROR("Error processing status\n");
+////////////////////////////////////////////////////////////////////////////////////////////
+// Capture the raw S? responses, and start a burst on ignition, tapping, a lock, an alarm,
+// a boiler state we do not know yet, or values out of range. Each complete frame goes into
+// the ring, also when it could not be decoded, as those are the frames worth looking at
+bool post_burst(const byte *data, uint16_t length) 
+{
+  if (!mqtt.beginPublish("Intergas/burst", length, false))
     return false;
+  mqtt.writePayload(data, length);
+  return mqtt.endPublish();
+}
+
+#define BURST_ALARM     0x80
+#define BURST_REJECTED  0x40
+
+// the reason of each frame, a burst starts when it changes and lasts the window
+void capture(Boiler &b, uint8_t previous, bool rejected)
+{
+  BurstCapture &burst = *b.burst;
+  const byte *frame = b.link.frame();
+  burst.add(frame, b.link.length());
+
+  uint8_t reason = 0;
+  if (b.link.length() > 26 && (frame[26] & 0x04))   // the alarm flag of the S? layout
+    reason = BURST_ALARM;
+  else if (b.device.state != previous)
+  {
+    switch (b.device.state) {
+    case HAIntergas::HEATING:
+    case HAIntergas::HOT_WATER:
+    case HAIntergas::LOCK:
+    case HAIntergas::UNKNOWN:
+      reason = b.device.state;
+      break;
+    default:
+      break;
+    }
   }
-  return true;
+  if (!reason && rejected)
+    reason = BURST_REJECTED;
+  if (burst.trigger(reason))
+    LOG_INFO("Burst capture for reason 0x%02x\n", reason);
+}
+
+// called from loop to collect the response, without waiting for it
+bool process_status(Boiler &b)
+{
+  BoilerLink &link = b.link;
+  BoilerLink::State result = link.loop();
+  if ((pipelined || (b.burst && b.burst->active())) && result != BoilerLink::IDLE && result != BoilerLink::BUSY)
+    b.gap.set(min_gap);               // the gap counts from the end of the response
+
+  switch (result) 
+  {
+  case BoilerLink::COMPLETE:
+    diag.commands++;
+    metrics.capture(&b - boilers, link.command(), link.frame(), link.length());
+    for (int i=0; i<DIAGNOSTICS_RTT; i++)
+      if (link.command() == commands[i].cmd)
+        diag.rtt[i].add(link.elapsed());
+    break;
+  case BoilerLink::TIMEOUT:
+    LOG_ERROR("No response from boiler %d\n", int(&b - boilers));
+    return false;
+  case BoilerLink::FRAMING:
+    LOG_ERROR("Incomplete response of %d bytes to %c%c\n", link.length(), link.command()[0], link.command()[1]);
+    return false;
+  default:
+    return true;
+  }
+  LOG_DEBUG("Response from boiler of %d bytes\n", link.length());  
+  DEBUG_BIN("Response from boiler: ", link.frame(), link.length());
+
+  HAIntergas &device = b.device;
+  uint8_t  previous = device.state;
+  uint32_t rejected = HAIntergasSensor::rejected;
+#ifdef CHECK_HEAP
+  uint32_t heap = ESP.getFreeHeap();
+#endif
+  uint32_t start = micros();
+  bool decoded = device.status(link.frame(), link.length(), link.command());
+  if (decoded)
+    diag.decode.add(micros() - start);
+  else
+    LOG_ERROR("Error processing status\n");
+  metrics.snapshot(&b - boilers);     // the http pages show the values of this frame
+  if (b.burst && link.command() == HAIntergas::STATUS_1)
+    capture(b, previous, HAIntergasSensor::rejected != rejected);
+  start = micros();
+  if (!device.publish())
+    LOG_ERROR(device.logmsg);
+  diag.publish.add(micros() - start);
+#ifdef CHECK_HEAP
+  if (ESP.getFreeHeap() != heap)      // lwip may hold on to a buffer of the posts, but that should level out
+    LOG_ERROR("Heap changed by %d bytes while processing %c%c\n", int(ESP.getFreeHeap() - heap), link.command()[0], link.command()[1]);
+#endif
+  return decoded;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////////////////
-Timer interval;
-
 enum Task {
-  WAIT,
-  STATUS1,
-  STATUS2,
-  STATUS3,
-  SENSORS
+  STATUS1 = HAIntergas::POLL_STATUS_1,
+  STATUS2 = HAIntergas::POLL_STATUS_2,
+  STATUS3 = HAIntergas::POLL_STATISTICS,
+  SENSORS = HAIntergas::POLL_SENSORS,
+  PRODUCT = HAIntergas::POLL_INFO,
+  WAIT    = HAIntergas::POLL_COUNT,
 };
 
-int current_task = WAIT;
+Timer    diag_interval;
 
-int scheduler(DateTime &now)
+// Each task has its own interval, which HAIntergas adjusts to the boiler state. Intervals are
+// evaluated each time, so a state change immediately brings forward what needs to be polled faster.
+// When pipelined S? and S2 are polled in turn, only the min gap after each response is kept.
+// The most overdue task of all boilers goes first, a boiler being polled is skipped until it has responded
+int scheduler(DateTime &now, Boiler *&which)
 {
-  if (!interval.passed())
+  uint32_t ms = millis();
+  int task = WAIT;
+  int32_t overdue = -1;
+  Boiler *spare = NULL;               // the first boiler that polls S? or S2 when nothing is due
+  int filler = WAIT;
+  for (int b=0; b<BOILERS; b++)
+  {
+    Boiler &boiler = boilers[b];
+    if (boiler.link.busy() || !boiler.gap.passed())
+      continue;
+
+    for (int i=0; i<HAIntergas::POLL_COUNT; i++)
+    {
+      int32_t late = ms - boiler.last_polled[i] - boiler.device.interval(HAIntergas::poll(i), now.month());
+      bool ahead = pipelined && (i == STATUS1 || i == STATUS2);   // polled in turn, see below
+      if (!ahead && late >= 0 && late > overdue) {    // the most overdue task goes first
+        overdue = late;
+        task = i;
+        which = &boiler;
+      }
+    }
+    if (spare)
+      continue;
+    if (pipelined)                                  // HN and the probes go first when due, then S? or S2, whichever is older
+      filler = int32_t(boiler.last_polled[STATUS1] - boiler.last_polled[STATUS2]) <= 0 ? STATUS1 : STATUS2;
+    else if (boiler.burst && boiler.burst->active())  // S? back-to-back, the others keep their slots
+      filler = STATUS1;
+    if (filler != WAIT)
+      spare = &boiler;
+  }
+  if (task == WAIT && spare) {
+    task = filler;
+    which = spare;
+  }
+  if (task == WAIT)
     return WAIT;
 
   led.blink();
+  which->last_polled[task] = ms;
+  if (!pipelined && !(which->burst && which->burst->active()))
+    which->gap.set(250);              // minimal gap between two tasks
+  return task;
+}
 
-  // TODO: we may adjust the timers depending on the month (summertime) or on room temp
-  // there is no use in updating all sensors when there is no heating demand
-  // Add this smart logic to HAIntergas and have it return the interval timing
-  
-  interval.set(1000);               // interval between readings is 1sec to keep them in sync
-  if (++current_task > SENSORS)       // set next task, rollover when reached the end
-    current_task = STATUS1;
-
-  bool active = (ketel.state != HAIntergas::IDLE);
-  if (!active && (current_task == SENSORS))
-    interval.set(10000);    // between readings the interval = 10s, except when there is demand
+#ifdef FUZZ_DECODER
+////////////////////////////////////////////////////////////////////////////////////////////
+// Decode random buffers of random length for each command. Nothing may crash, and buffers
+// shorter than a response must be rejected. Runs before connecting, so the decode time
+// excludes posting. Only for a test bench, the random values end up in the sensors
+void fuzz_decoder(HAIntergas &device, int rounds)
+{
+  const char *cmds[] = { HAIntergas::STATUS_1, HAIntergas::STATUS_2, HAIntergas::STATISTICS,
+                         HAIntergas::PROD_CODE, HAIntergas::PARAMS, HAIntergas::SETTINGS };
+  const int   minimum[] = { 30, 20, 24, 4, 4, 4 };
+  byte        frame[BOILER_LINK_BUFFER];
+  uint32_t    seed = 1, frames = 0, accepted = 0, us = 0;
 
-  return current_task;
+  SampleBuffer *saved = HAIntergasSensor::history;
+  HAIntergasSensor::history = NULL;
+  for (int r=0; r<rounds; r++)
+  {
+    for (int c=0; c<6; c++)
+    {
+      seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+      int lg = seed % (BOILER_LINK_BUFFER + 1);
+      for (int i=0; i<lg; i++) {
+        seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+        frame[i] = seed;
+      }
+      uint32_t start = micros();
+      if (device.status(frame, lg, cmds[c]) && lg < minimum[c])
+        accepted++;
+      us += micros() - start;
+      frames++;
+    }
+    yield();                          // keep the watchdog happy
+  }
+  HAIntergasSensor::history = saved;
+  LOG_INFO("Fuzzed %u frames, %u us per frame, %u too short frames accepted\n", frames, us / frames, accepted);
 }
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////////////////
 void setup() 
 {
-  wemos_serial.begin(9600);
-  INFO("\n\nIntergas Logger Version %s\n", VERSION);
-  wifi_connect();                      // 4) connect with WiFi
-  sync_rtc();
+  for (int b=0; b<BOILERS; b++)
+    boilers[b].port.begin(9600, 256);
+  LOG_INFO("\n\nIntergas Logger Version %s\n", VERSION);
+  wifi_connect();                      // 4) start connecting with WiFi, completed in the background
+  history.begin(unix_time);
+  burst.begin(unix_time);
+  HAIntergasSensor::history = &history;
 
-  INFO("Connecting to MQTT server %s\n", mqtt_server);
+  LOG_INFO("Connecting to MQTT server %s\n", mqtt_server);
   uint8_t mac[6];
   WiFi.macAddress(mac);
-  ketel.begin(mac, &mqtt);             // 5) make sure the device gets a unique ID (based on mac address)
+  for (int b=0; b<BOILERS; b++)         // 5) make sure the device gets a unique ID (based on mac address)
+  {
+    HAIntergas &device = boilers[b].device;
+    if (!device.begin(mac, &mqtt, mqtt_batched))
+      LOG_ERROR(device.logmsg);
+    if (*device.found())
+      LOG_INFO("%s\n", device.found());
+  }
+  diag.begin(&mqtt);
+#ifdef FUZZ_DECODER
+  fuzz_decoder(ketel, FUZZ_DECODER);
+#endif
+#if defined(SIMULATE_BOILER) && defined(SIMULATE_FUZZ)
+  wemos_serial.fuzz = SIMULATE_FUZZ;
+#endif
+  char seed[32];                       // not the build time, a rebuild of the same sources has the same configs
+  snprintf(seed, sizeof(seed), "%s %d %d", VERSION, mqtt_batched, BOILERS);
+  discovery = HAIntergasSensor::discoveryHash(seed);
   mqtt.onConnected(mqtt_connect);      // register function called when newly connected
+  mqtt.onMessage(mqtt_message);
   mqtt.begin(mqtt_server, mqtt_port, mqtt_user, mqtt_passwd);  // 
 
-  if (!ketel.logmsg.isEmpty())
-    ERROR(ketel.logmsg.c_str());
-
-  INFO("Initialize OTA\n");
+  LOG_INFO("Initialize OTA\n");
   ArduinoOTA.setPort(8266);
   ArduinoOTA.setHostname("Intergas-Logger");
   ArduinoOTA.setPassword(OTA_PASS);
 
   ArduinoOTA.onStart([]() {
-    INFO("Starting remote software update");
+    LOG_INFO("Starting remote software update");
   });
   ArduinoOTA.onEnd([]() {
-    INFO("Remote software update finished");
+    LOG_INFO("Remote software update finished");
   });
   ArduinoOTA.onProgress([](unsigned int progress, unsigned int total) {
   });
   ArduinoOTA.onError([](ota_error_t error) {
-    ERROR("Error remote software update");
+    LOG_ERROR("Error remote software update");
   });
   ArduinoOTA.begin();
-  INFO("Setup complete\n\n");
+
+  HAIntergas *devices[BOILERS];
+  for (int b=0; b<BOILERS; b++)
+    devices[b] = &boilers[b].device;
+  metrics.begin(devices, BOILERS);
+
+  for (int b=0; b<BOILERS; b++)
+    for (int i=0; i<HAIntergas::POLL_COUNT; i++)
+      boilers[b].last_polled[i] = millis() - 3600000UL;    // poll everything right away
+  LOG_INFO("Setup complete\n\n");
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
@@ -185,33 +565,75 @@ void setup()
 ////////////////////////////////////////////////////////////////////////////////////////////
 void loop() 
 {
-  // ensure we are still connected (STA-mode)
-  wifi_connect();
+  static uint32_t last_loop = micros();
+  uint32_t us = micros();
+  diag.loop.add(us - last_loop);
+  last_loop = us;
   // handle any OTA requests
   ArduinoOTA.handle();
-  // handle MQTT
-  mqtt.loop();
+  // handle MQTT, and post what was stored while disconnected
+  if (wifi_connect()) {
+    mqtt.loop();
+    if (HAIntergasSensor::announce && mqtt.isConnected()) {  // the configs were posted while connecting
+      Persist::save(PERSIST_CONFIG, &discovery, sizeof(discovery));
+      HAIntergasSensor::announce = false;
+    }
+    sync_rtc();
+    drain_history();
+    if (boilers_idle())               // a scrape never delays a response of the boiler
+      metrics.loop();
+  }
+  if (diag.sampled())
+    LOG_INFO("First sample posted %u ms after connecting, %u ms after boot\n", diag.connect_to_sample, diag.boot_to_sample);
+  flush_log();
+  // collect any response from the boilers, and stream the burst frames while not talking to the boiler
+  for (int b=0; b<BOILERS; b++)
+  {
+    process_status(boilers[b]);
+    if (boilers[b].burst && !boilers[b].link.busy() && mqtt.isConnected())
+      boilers[b].burst->flush(post_burst);
+  }
   // whats the time
   DateTime now = rtc.now();
   // now lets deterime what we are going to do
-
-  switch(scheduler(now)) {
+  Boiler *which = NULL;
+  int task = scheduler(now, which);
+  switch(task) {
     default:
     case WAIT:       
       break;
     case STATUS1:
-      retrieve_status(now, HAIntergas::STATUS_1);      break;
+      retrieve_status(now, *which, commands[0]);      break;
     case STATUS2:
-      retrieve_status(now, HAIntergas::STATUS_2);      break;
+      retrieve_status(now, *which, commands[1]);      break;
     case STATUS3:
-      retrieve_status(now, HAIntergas::STATISTICS);    break;
+      retrieve_status(now, *which, commands[2]);      break;
+    case PRODUCT:
+      retrieve_status(now, *which, command_of(which->device.info_command()));   break;
     case SENSORS:
-      INFO("[%s] - Reading temperature sensors\n", 
-                now.timestamp(DateTime::TIMESTAMP_TIME).c_str());
-      if (ketel.sensors())
-        ERROR(ketel.logmsg.c_str());
+      if (!which->device.sensors())
+        break;                      // the previous conversion is still being collected
+      which->conversion_start = millis();
+      LOG_DEBUG("[%s] - Reading temperature sensors\n", time_of(now));
       break;
   }
+  // collect the temperatures once converted, while the boilers are being polled
+  uint32_t serial_errors = 0;
+  for (int b=0; b<BOILERS; b++)
+  {
+    int converted = boilers[b].device.sensors_loop();
+    if (converted < 0)
+      LOG_ERROR(boilers[b].device.logmsg);
+    if (converted)
+      diag.conversion.add(millis() - boilers[b].conversion_start);
+    serial_errors += boilers[b].link.errors();
+  }
+
+  if (diag_interval.passed()) {
+    diag_interval.set(60000);
+    diag.serial_errors = serial_errors;
+    diag.publish_all();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
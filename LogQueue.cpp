@@ -0,0 +1,77 @@
+#include "LogQueue.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+LogQueue::LogQueue(Level l, uint16_t i, uint8_t b)
+: _head(0), _count(0), _credit(uint32_t(i) * b), _refilled(0), level(l), interval(i), burst(b), dropped(0), coalesced(0)
+{
+}
+
+void LogQueue::push(const char *msg, Level l)
+{
+  if (l > level || !*msg)
+    return;
+
+  if (_count) {
+    Line &last = _ring[(_head + _count - 1) % LOG_QUEUE_SIZE];
+    if (last.level == l && strncmp(last.text, msg, LOG_QUEUE_LINE - 1) == 0) {
+      if (last.repeated < 0xFFFF)
+        last.repeated++;
+      coalesced++;
+      return;
+    }
+  }
+  if (_count == LOG_QUEUE_SIZE) {   // make room by dropping the oldest
+    _head = (_head + 1) % LOG_QUEUE_SIZE;
+    _count--;
+    dropped++;
+  }
+  Line &line = _ring[(_head + _count) % LOG_QUEUE_SIZE];
+  line.level = l;
+  line.repeated = 0;
+  strncpy(line.text, msg, LOG_QUEUE_LINE - 1);
+  line.text[LOG_QUEUE_LINE - 1] = 0;
+  _count++;
+}
+
+bool LogQueue::_take_token()
+{
+  uint32_t now = millis();
+  uint32_t full = uint32_t(interval) * burst;
+  _credit += min(now - _refilled, full);   // capped before adding, so it can not wrap
+  _refilled = now;
+  if (_credit > full)
+    _credit = full;
+  if (_credit < interval)
+    return false;
+  _credit -= interval;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// join as many lines as fit into one message
+////////////////////////////////////////////////////////////////////////////////////////////
+bool LogQueue::flush(bool (*post)(const char *msg))
+{
+  if (_count == 0 || !_take_token())
+    return false;
+
+  int pos = 0;
+  while (_count)
+  {
+    Line &line = _ring[_head];
+    char repeat[16] = "";
+    if (line.repeated)
+      snprintf(repeat, sizeof(repeat), " (x%u)", line.repeated + 1);
+    int lg = strlen(line.text) + strlen(repeat) + 1;
+    if (pos + lg >= LOG_QUEUE_BATCH && pos > 0)
+      break;                        // the rest goes in the next message
+    pos += snprintf(_batch + pos, LOG_QUEUE_BATCH - pos, "%s%s%s", pos ? "\n" : "", line.text, repeat);
+    if (pos >= LOG_QUEUE_BATCH)
+      pos = LOG_QUEUE_BATCH - 1;
+    _head = (_head + 1) % LOG_QUEUE_SIZE;
+    _count--;
+  }
+  return post(_batch);
+}
@@ -0,0 +1,53 @@
+/*
+ * Remote logging without holding up the main loop
+ *
+ * Log lines are queued in a ring in RAM and posted later, several lines per message, from a
+ * point in the loop where nothing time critical is going on. Repeated lines are coalesced
+ * into one with a count, and a token bucket limits how many messages are posted.
+ */
+#ifndef LOG_QUEUE
+#define LOG_QUEUE
+
+#include <Arduino.h>
+
+#define LOG_QUEUE_SIZE    16      // lines in the ring
+#define LOG_QUEUE_LINE    112     // max length of a line, longer lines are truncated
+#define LOG_QUEUE_BATCH   512     // max size of a posted message
+
+class LogQueue
+{
+public:
+  enum Level : uint8_t {
+    ERROR_LEVEL = 1,
+    INFO_LEVEL  = 2,
+    DEBUG_LEVEL = 3,
+  };
+
+private:
+  struct Line {
+    Level     level;
+    uint16_t  repeated;   // times the same line was logged after this one
+    char      text[LOG_QUEUE_LINE];
+  };
+  Line      _ring[LOG_QUEUE_SIZE];
+  uint8_t   _head;        // oldest line
+  uint8_t   _count;
+  uint32_t  _credit;      // ms of posting time saved up, one message per interval
+  uint32_t  _refilled;    // ms timestamp of the last refill
+  char      _batch[LOG_QUEUE_BATCH];
+
+  bool _take_token();
+public:
+  Level     level;        // lines above this level are not queued
+  uint16_t  interval;     // ms per message
+  uint8_t   burst;        // messages which may be posted in a row
+  uint32_t  dropped;      // lines lost as the ring was full
+  uint32_t  coalesced;    // lines merged with the previous one
+
+  LogQueue(Level l = INFO_LEVEL, uint16_t interval = 2000, uint8_t burst = 4);
+  void push(const char *msg, Level l);
+  bool flush(bool (*post)(const char *msg));    // posts at most one message, when a token is available
+  uint8_t count() const { return _count; };
+};
+
+#endif
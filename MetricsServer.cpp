@@ -0,0 +1,179 @@
+#include "MetricsServer.h"
+#include <stdarg.h>
+
+static const char *COMMANDS[METRICS_COMMANDS] = { "S?", "S2", "HN" };
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+MetricsServer::MetricsServer(int port)
+: _server(port), _count(0), _pos(0), requests(0)
+{
+  memset(_frames, 0, sizeof(_frames));
+  for (int i=0; i<INTERGAS_REGISTRY; i++)
+    _values[i] = INT32_MIN;
+  memset(_states, 0, sizeof(_states));
+  memset(_alarms, 0, sizeof(_alarms));
+}
+
+void MetricsServer::begin(HAIntergas **boilers, int count)
+{
+  _count = min(count, INTERGAS_MAX_BOILERS);
+  for (int i=0; i<_count; i++)
+    _boilers[i] = boilers[i];
+  _server.on("/metrics", [this]() { _prometheus(); });
+  _server.on("/json",    [this]() { _json(); });
+  _server.begin();
+}
+
+void MetricsServer::capture(int boiler, const char *command, const byte *frame, int length)
+{
+  int cmd = command == HAIntergas::STATUS_1 ? 0 : command == HAIntergas::STATUS_2 ? 1 :
+            command == HAIntergas::STATISTICS ? 2 : -1;
+  if (cmd < 0 || boiler < 0 || boiler >= INTERGAS_MAX_BOILERS)
+    return;
+  Frame &f = _frames[boiler][cmd];
+  f.length = min(length, METRICS_FRAME);
+  memcpy(f.data, frame, f.length);
+  f.time = millis();
+  if (f.time == 0)
+    f.time = 1;
+}
+
+void MetricsServer::snapshot(int boiler)
+{
+  for (int i=0; i<HAIntergasSensor::count; i++)
+  {
+    HANumeric number = HAIntergasSensor::registry[i]->getCurrentValue();
+    _values[i] = number.isSet() ? int32_t(number.getBaseValue()) : INT32_MIN;
+  }
+  if (boiler < 0 || boiler >= _count)
+    return;
+  _states[boiler] = _boilers[boiler]->state;
+  _alarms[boiler] = _boilers[boiler]->alarm.getCurrentState();
+}
+
+void MetricsServer::loop()
+{
+  _server.handleClient();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// rendering, the chunk is send when full
+////////////////////////////////////////////////////////////////////////////////////////////
+void MetricsServer::_add(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int lg = vsnprintf(_chunk + _pos, METRICS_CHUNK - _pos, format, args);
+  va_end(args);
+  if (_pos + lg >= METRICS_CHUNK)       // did not fit, send what we have and render it again
+  {
+    _flush();
+    va_start(args, format);
+    lg = vsnprintf(_chunk, METRICS_CHUNK, format, args);
+    va_end(args);
+    if (lg >= METRICS_CHUNK)
+      lg = METRICS_CHUNK - 1;           // truncated, only when a single line is too long
+  }
+  _pos += lg;
+}
+
+void MetricsServer::_hex(const Frame &frame)
+{
+  for (int i=0; i<frame.length; i++)
+    _add("%02x", frame.data[i]);
+}
+
+// the value of sensor i in the snapshot, with the decimals of its precision. 0 when not set
+int MetricsServer::_value(char *dst, int i)
+{
+  if (_values[i] == INT32_MIN)
+    return 0;
+  HANumeric number;
+  number.setPrecision(HAIntergasSensor::registry[i]->precision());
+  number.setBaseValue(_values[i]);
+  int lg = number.toStr(dst);
+  dst[lg] = 0;
+  return lg;
+}
+
+void MetricsServer::_flush()
+{
+  if (_pos)
+    _server.sendContent(_chunk, _pos);
+  _pos = 0;
+}
+
+void MetricsServer::_prometheus()
+{
+  requests++;
+  _server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  _server.send(200, "text/plain; version=0.0.4", "");
+  _pos = 0;
+
+  char value[16];
+  _add("# TYPE intergas_value gauge\n");
+  for (int i=0; i<HAIntergasSensor::count; i++)
+  {
+    if (_value(value, i))
+      _add("intergas_value{sensor=\"%s\"} %s\n", HAIntergasSensor::registry[i]->uniqueId(), value);
+  }
+  _add("# TYPE intergas_state gauge\n");
+  for (int b=0; b<_count; b++)
+    _add("intergas_state{boiler=\"%d\"} %d\nintergas_alarm{boiler=\"%d\"} %d\n",
+         b, _states[b], b, _alarms[b]);
+  _add("# TYPE intergas_frame_age_ms gauge\n");
+  uint32_t now = millis();
+  for (int b=0; b<_count; b++)
+    for (int c=0; c<METRICS_COMMANDS; c++)
+    {
+      const Frame &f = _frames[b][c];
+      if (!f.time)
+        continue;
+      _add("intergas_frame_age_ms{boiler=\"%d\",command=\"%s\"} %lu\n", b, COMMANDS[c], (unsigned long) (now - f.time));
+    }
+  _add("intergas_uptime_ms %lu\nintergas_free_heap %lu\n", (unsigned long) now, (unsigned long) ESP.getFreeHeap());
+  _flush();
+  _server.sendContent("", 0);           // last chunk
+}
+
+void MetricsServer::_json()
+{
+  requests++;
+  _server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  _server.send(200, "application/json", "");
+  _pos = 0;
+
+  char value[16];
+  _add("{\"uptime\":%lu,\"values\":{", (unsigned long) millis());
+  bool first = true;
+  for (int i=0; i<HAIntergasSensor::count; i++)
+  {
+    if (!_value(value, i))
+      continue;
+    _add("%s\"%s\":%s", first ? "" : ",", HAIntergasSensor::registry[i]->uniqueId(), value);
+    first = false;
+  }
+  _add("},\"boilers\":[");
+  uint32_t now = millis();
+  for (int b=0; b<_count; b++)
+  {
+    _add("%s{\"state\":%d,\"alarm\":%s,\"frames\":{", b ? "," : "", _states[b], _alarms[b] ? "true" : "false");
+    first = true;
+    for (int c=0; c<METRICS_COMMANDS; c++)
+    {
+      const Frame &f = _frames[b][c];
+      if (!f.time)
+        continue;
+      _add("%s\"%s\":{\"age\":%lu,\"data\":\"", first ? "" : ",", COMMANDS[c], (unsigned long) (now - f.time));
+      _hex(f);
+      _add("\"}");
+      first = false;
+    }
+    _add("}}");
+  }
+  _add("]}");
+  _flush();
+  _server.sendContent("", 0);
+}
@@ -0,0 +1,58 @@
+/*
+ * Local HTTP endpoint with the latest values, for when the MQTT broker can not be reached
+ *
+ *   /metrics   Prometheus text format, the age of the raw frames but not their bytes
+ *   /json      the same as a json document, with the raw frames in hex
+ *
+ * The values of the sensors in the registry are copied into a snapshot each time a response
+ * has been decoded, so a page shows them as of the same frame. The raw frames are copied here
+ * as they are received. Responses are rendered in small chunks from a fixed buffer, nothing is
+ * allocated for the body. Call loop() only while the boilers are not being polled.
+ */
+#ifndef METRICS_SERVER
+#define METRICS_SERVER
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+#include "HAIntergas.h"
+
+#define METRICS_CHUNK     256     // bytes rendered before being send
+#define METRICS_FRAME     32      // max length of a kept frame
+#define METRICS_COMMANDS  3       // S?, S2 and HN
+
+class MetricsServer
+{
+private:
+  struct Frame {
+    uint32_t  time;       // ms timestamp, 0 when not yet received
+    uint8_t   length;
+    byte      data[METRICS_FRAME];
+  };
+  ESP8266WebServer  _server;
+  Frame     _frames[INTERGAS_MAX_BOILERS][METRICS_COMMANDS];
+  HAIntergas *_boilers[INTERGAS_MAX_BOILERS];
+  uint8_t   _count;
+  // snapshot of the decoded values, in units of the precision of each sensor
+  int32_t   _values[INTERGAS_REGISTRY];     // INT32_MIN when not set
+  uint8_t   _states[INTERGAS_MAX_BOILERS];
+  bool      _alarms[INTERGAS_MAX_BOILERS];
+  char      _chunk[METRICS_CHUNK];
+  int       _pos;
+
+  void _add(const char *format, ...);
+  void _hex(const Frame &frame);
+  int  _value(char *dst, int i);
+  void _flush();
+  void _prometheus();
+  void _json();
+public:
+  uint32_t  requests;
+
+  MetricsServer(int port = 80);
+  void begin(HAIntergas **boilers, int count);
+  void capture(int boiler, const char *command, const byte *frame, int length);   // keep the last raw frame
+  void snapshot(int boiler);                                                       // keep the values, once a frame is decoded
+  void loop();
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include "PerfStat.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+void PerfStat::reset()
+{
+  _min = 0xFFFFFFFF;
+  _max = 0;
+  _count = 0;
+  _sum = 0;
+  memset(_hist, 0, sizeof(_hist));
+}
+
+// the two bits after the most significant bit select one of the 4 buckets of its power of 2
+uint8_t PerfStat::_bucket(uint32_t value)
+{
+  if (value < 4)
+    return value;
+  uint8_t msb = 31 - __builtin_clz(value);
+  return (msb << 2) | ((value >> (msb - 2)) & 3);
+}
+
+uint32_t PerfStat::_lower(uint8_t bucket)
+{
+  uint8_t msb = bucket >> 2;
+  if (msb < 2)
+    return bucket;
+  return (4 | (bucket & 3)) << (msb - 2);
+}
+
+void PerfStat::add(uint32_t value)
+{
+  if (value < _min)
+    _min = value;
+  if (value > _max)
+    _max = value;
+  _count++;
+  _sum += value;
+  if (++_hist[_bucket(value)] < 0xFFFF)
+    return;
+  for (int b=0; b<PERF_STAT_BUCKETS; b++)   // halve all buckets before one saturates, a single value stays
+    _hist[b] = (_hist[b] + 1) >> 1;
+}
+
+uint32_t PerfStat::percentile(uint8_t pct) const
+{
+  if (_count == 0)
+    return 0;
+  uint32_t total = 0;                   // in the histogram, which may have been halved
+  for (int b=0; b<PERF_STAT_BUCKETS; b++)
+    total += _hist[b];
+  uint32_t rank = ((uint64_t) total * pct + 99) / 100;
+  uint32_t seen = 0;
+  for (int b=0; b<PERF_STAT_BUCKETS; b++)
+  {
+    seen += _hist[b];
+    if (seen >= rank) {
+      uint32_t value = (b + 1 < PERF_STAT_BUCKETS) ? _lower(b + 1) - 1 : _max;   // upper bound of the bucket
+      return value > _max ? _max : value;
+    }
+  }
+  return _max;
+}
+
+int PerfStat::toJson(char *buffer, int size) const
+{
+  return snprintf(buffer, size, "{\"min\":%lu,\"avg\":%lu,\"max\":%lu,\"p95\":%lu,\"n\":%lu}", 
+                  (unsigned long) min(), (unsigned long) avg(), (unsigned long) max(), 
+                  (unsigned long) percentile(95), (unsigned long) _count);
+}
@@ -0,0 +1,37 @@
+/*
+ * Low overhead timing statistics
+ *
+ * Keeps min, max, sum and a histogram with 4 buckets per power of 2, from which the
+ * percentiles are estimated. Adding a value takes a few instructions, no floats. When a bucket
+ * would overflow all buckets are halved, so the percentiles keep their shape.
+ */
+#ifndef PERF_STAT
+#define PERF_STAT
+
+#include <Arduino.h>
+
+#define PERF_STAT_BUCKETS   128   // 32 powers of 2, 4 buckets each
+
+class PerfStat
+{
+private:
+  uint32_t  _min, _max;
+  uint32_t  _count;
+  uint64_t  _sum;
+  uint16_t  _hist[PERF_STAT_BUCKETS];
+
+  static uint8_t  _bucket(uint32_t value);
+  static uint32_t _lower(uint8_t bucket);
+public:
+  PerfStat() { reset(); };
+  void      reset();
+  void      add(uint32_t value);
+  uint32_t  count() const { return _count; };
+  uint32_t  min()   const { return _count ? _min : 0; };
+  uint32_t  max()   const { return _max; };
+  uint32_t  avg()   const { return _count ? _sum / _count : 0; };
+  uint32_t  percentile(uint8_t pct) const;
+  int       toJson(char *buffer, int size) const;   // {"min":..,"avg":..,"max":..,"p95":..,"n":..}
+};
+
+#endif
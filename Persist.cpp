@@ -0,0 +1,55 @@
+#include "Persist.h"
+#include <EEPROM.h>
+
+bool Persist::_begun = false;
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+void Persist::begin()
+{
+  if (_begun)
+    return;
+  EEPROM.begin(PERSIST_SIZE);
+  _begun = true;
+}
+
+uint8_t Persist::_checksum(const void *data, int size)
+{
+  const uint8_t *p = (const uint8_t *) data;
+  uint8_t crc = 0;
+  while (size--) {                  // CRC-8, polynomial 0x07
+    crc ^= *p++;
+    for (int i=0; i<8; i++)
+      crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+bool Persist::load(int offset, void *data, int size)
+{
+  begin();
+  if (offset + size + 2 > PERSIST_SIZE)
+    return false;
+  const uint8_t *stored = EEPROM.getConstDataPtr() + offset;
+  if (stored[0] != PERSIST_MAGIC || stored[1] != _checksum(stored + 2, size))
+    return false;
+  memcpy(data, stored + 2, size);
+  return true;
+}
+
+bool Persist::save(int offset, const void *data, int size)
+{
+  begin();
+  if (offset + size + 2 > PERSIST_SIZE)
+    return false;
+  uint8_t crc = _checksum(data, size);
+  const uint8_t *stored = EEPROM.getConstDataPtr() + offset;
+  if (stored[0] == PERSIST_MAGIC && stored[1] == crc && memcmp(stored + 2, data, size) == 0)
+    return true;                    // unchanged
+  uint8_t *p = EEPROM.getDataPtr() + offset;
+  p[0] = PERSIST_MAGIC;
+  p[1] = crc;
+  memcpy(p + 2, data, size);
+  return EEPROM.commit();
+}
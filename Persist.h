@@ -0,0 +1,30 @@
+/*
+ * Small records kept in flash across reboots, using the EEPROM emulation of the ESP8266
+ *
+ * Each record is stored with a magic and a checksum, so an erased or outdated record reads as
+ * absent. Records are only written when their content has changed, to spare the flash.
+ */
+#ifndef PERSIST
+#define PERSIST
+
+#include <Arduino.h>
+
+#define PERSIST_SIZE        512     // bytes of flash reserved for the records
+#define PERSIST_MAGIC       0xA5
+// offsets of the records, each record takes 2 bytes more than its data
+#define PERSIST_PROBES      0       // DS18B20 addresses, 66 bytes per boiler
+#define PERSIST_CONFIG      160     // hash of the discovery configs last announced
+#define PERSIST_CALIBRATION 192     // of the gas counters, 34 bytes per boiler
+
+class Persist
+{
+private:
+  static bool _begun;
+  static uint8_t _checksum(const void *data, int size);
+public:
+  static void begin();
+  static bool load(int offset, void *data, int size);         // false when absent or corrupt
+  static bool save(int offset, const void *data, int size);   // false when it could not be written
+};
+
+#endif
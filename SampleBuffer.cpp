@@ -0,0 +1,100 @@
+#include "SampleBuffer.h"
+#ifdef SAMPLE_FLASH_OVERFLOW
+#include <LittleFS.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+SampleBuffer::SampleBuffer()
+: _head(0), _count(0), _flashed(0), _drained(0), _clock(NULL), dropped(0)
+{
+}
+
+void SampleBuffer::begin(uint32_t (*clock)())
+{
+  _clock = clock;
+#ifdef SAMPLE_FLASH_OVERFLOW
+  LittleFS.begin();
+  LittleFS.remove(SAMPLE_FLASH_FILE);     // records of a previous run can not be trusted
+#endif
+}
+
+// returns false when the record could not be stored in flash
+bool SampleBuffer::_overflow(const Sample &s)
+{
+#ifdef SAMPLE_FLASH_OVERFLOW
+  if ((_flashed + 1) * sizeof(Sample) > SAMPLE_FLASH_MAX)
+    return false;
+  File file = LittleFS.open(SAMPLE_FLASH_FILE, "a");
+  if (!file)
+    return false;
+  bool result = file.write((const uint8_t *) &s, sizeof(Sample)) == sizeof(Sample);
+  file.close();
+  if (result)
+    _flashed++;
+  return result;
+#else
+  return false;
+#endif
+}
+
+void SampleBuffer::push(uint8_t sensor, int32_t value)
+{
+  if (_count == SAMPLE_BUFFER_SIZE)
+  {
+    if (!_overflow(_ring[_head]))       // make room by moving the oldest record to flash
+      dropped++;
+    _head = (_head + 1) % SAMPLE_BUFFER_SIZE;
+    _count--;
+  }
+  Sample &s = _ring[(_head + _count) % SAMPLE_BUFFER_SIZE];
+  s.time = _clock ? _clock() : 0;
+  s.sensor = sensor;
+  s.value = value;
+  _count++;
+}
+
+bool SampleBuffer::peek(Sample &s, uint32_t i)
+{
+  uint32_t flashed = _flashed - _drained;
+#ifdef SAMPLE_FLASH_OVERFLOW
+  if (i < flashed)                      // the records in flash are older
+  {
+    File file = LittleFS.open(SAMPLE_FLASH_FILE, "r");
+    bool result = file && file.seek((_drained + i) * sizeof(Sample)) &&
+                  file.read((uint8_t *) &s, sizeof(Sample)) == sizeof(Sample);
+    file.close();
+    if (result)
+      return true;
+    if (i)
+      return false;                     // post what was read, the next batch starts at this record
+    dropped += flashed;                 // the file can not be read, continue with the ring
+    LittleFS.remove(SAMPLE_FLASH_FILE);
+    _flashed = _drained = 0;
+    flashed = 0;
+  }
+#endif
+  i -= flashed;
+  if (i >= _count)
+    return false;
+
+  s = _ring[(_head + i) % SAMPLE_BUFFER_SIZE];
+  return true;
+}
+
+void SampleBuffer::remove(uint32_t n)
+{
+#ifdef SAMPLE_FLASH_OVERFLOW
+  for (; n && _drained < _flashed; n--)
+    _drained++;
+  if (_flashed && _drained >= _flashed) {
+    LittleFS.remove(SAMPLE_FLASH_FILE);
+    _flashed = _drained = 0;
+  }
+#endif
+  if (n > _count)
+    n = _count;
+  _head = (_head + n) % SAMPLE_BUFFER_SIZE;
+  _count -= n;
+}
@@ -0,0 +1,47 @@
+/*
+ * Store and forward of sensor values while the MQTT broker can not be reached
+ *
+ * Values are kept as compact binary records in a fixed size ring in RAM. When the ring is full
+ * the oldest records are moved to a file in flash (when SAMPLE_FLASH_OVERFLOW is defined),
+ * otherwise they are dropped. Once connected again, the records are drained oldest first, and
+ * only removed once they have been posted.
+ */
+#ifndef SAMPLE_BUFFER
+#define SAMPLE_BUFFER
+
+#include <Arduino.h>
+
+#define SAMPLE_BUFFER_SIZE  512           // records in RAM, 9 bytes each
+//#define SAMPLE_FLASH_OVERFLOW             // move the oldest records to LittleFS when the ring is full
+#define SAMPLE_FLASH_FILE   "/samples.bin"
+#define SAMPLE_FLASH_MAX    65536         // max bytes in the flash file
+
+struct __attribute__((packed)) Sample {
+  uint32_t  time;       // unix time
+  uint8_t   sensor;     // index of the sensor
+  int32_t   value;      // value scaled to the precision of the sensor
+};
+
+class SampleBuffer
+{
+private:
+  Sample    _ring[SAMPLE_BUFFER_SIZE];
+  uint16_t  _head;          // oldest record
+  uint16_t  _count;
+  uint32_t  _flashed;       // records in the flash file
+  uint32_t  _drained;       // records already read from the flash file
+  uint32_t (*_clock)();
+
+  bool _overflow(const Sample &s);
+public:
+  uint32_t  dropped;        // records lost as the buffer was full
+
+  SampleBuffer();
+  void begin(uint32_t (*clock)());            // clock returns the unix time for new records
+  void push(uint8_t sensor, int32_t value);
+  bool peek(Sample &s, uint32_t i = 0);       // the i-th oldest record, false when there are fewer
+  void remove(uint32_t n);                    // the n oldest records, once they have been posted
+  uint32_t count() const { return _count + _flashed - _drained; };
+};
+
+#endif
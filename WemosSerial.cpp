@@ -12,12 +12,13 @@
 //
 ////////////////////////////////////////////////////////////////////////
 WemosSerial::WemosSerial()
-: HardwareSerial(UART1)
+: HardwareSerial(UART1), _errors(0)
 {
 }
 
-bool WemosSerial::begin(int baudrate)
+bool WemosSerial::begin(int baudrate, int rx_buffer)
 {
+  Serial.setRxBufferSize(rx_buffer);                                  // to be set before begin
   Serial.begin(baudrate, SERIAL_8N1, SERIAL_RX_ONLY);                 // UART0 for rx only
   Serial.pins(TXD2, RXD2);                                            // using pin RXD2 (D7)
   HardwareSerial::begin(baudrate, SERIAL_8N1, SERIAL_TX_ONLY, TXD1);  // UART1 for TX, on D4
@@ -36,3 +37,26 @@ int WemosSerial::available() {
 int WemosSerial::read() {
   return Serial.read();
 }
+
+// reads the bytes in one go, instead of one call per byte
+int WemosSerial::readBytes(byte *buffer, int length) {
+  if (Serial.hasOverrun())              // bytes lost as the RX buffer was full
+    _errors++;
+  if (Serial.hasRxError())              // framing or parity error
+    _errors++;
+  int lg = Serial.available();
+  if (lg > length)
+    lg = length;
+  if (lg <= 0)
+    return 0;
+  return Serial.read((char *) buffer, lg);
+}
+
+int WemosSerial::discard() {
+  char dummy[32];
+  int dropped = 0;
+  int lg;
+  while ((lg = Serial.available()) > 0)
+    dropped += Serial.read(dummy, lg < (int) sizeof(dummy) ? lg : sizeof(dummy));
+  return dropped;
+}
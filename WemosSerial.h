@@ -19,18 +19,24 @@
 #define WEMOS_SERIAL
 
 #include <HardwareSerial.h>
+#include "BoilerPort.h"
 
-class WemosSerial : private HardwareSerial 
+class WemosSerial : public BoilerPort, private HardwareSerial
 {
+private:
+  uint32_t _errors;
 public:
   WemosSerial();
-  // configure UART0 for RX, and UART1 for TX
-  bool begin(int baudrate); 
+  // configure UART0 for RX, and UART1 for TX. The RX buffer should hold at least a full response
+  bool begin(int baudrate, int rx_buffer = 256); 
   // serial output is redirected using UART1 on pin D4 (TXD1)
   bool print(const char*s);
   // serial input is redirected to Serial, using UART0 on pin D7 (RX02)
   int available();
   int read();
+  int readBytes(byte *buffer, int length);
+  int discard();
+  uint32_t errors() { return _errors; };
 };
 
 #endif
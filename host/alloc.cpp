@@ -0,0 +1,54 @@
+/*
+ * Checks that polling, decoding, posting and logging do not allocate once running
+ *
+ * Counts the calls of operator new while the sessions are replayed through the sketch. Setup and
+ * connecting may allocate, as the library builds the discovery configs on the heap, a steady
+ * poll cycle may not. Pass -v to see the log lines.
+ */
+#define SIMULATE_BOILER
+#include "../Intergas2MQTT.ino"
+#include <new>
+
+static bool     counting = false;
+static uint32_t allocations = 0;
+
+void *operator new(size_t size)
+{
+  if (counting)
+    allocations++;
+  void *p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+static void run(uint32_t seconds)
+{
+  for (uint32_t ms=0; ms<seconds * 1000; ms++) {
+    loop();
+    host::advance(1000);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  host::verbose = argc > 1 && !strcmp(argv[1], "-v");
+  setup();
+  run(120);                             // connected, clock synchronized and the static data read
+  uint32_t polls = led.blinks;
+  counting = true;
+  run(600);
+  counting = false;
+
+  printf("%u allocations in %u polls\n", allocations, led.blinks - polls);
+  if (!mqtt.isConnected() || led.blinks == polls) {
+    printf("FAILED: nothing was polled\n");
+    return 1;
+  }
+  return allocations ? 1 : 0;
+}
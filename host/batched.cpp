@@ -0,0 +1,112 @@
+/*
+ * Replays the sessions of Protocol.txt with mqtt_batched set, and parses each json document
+ *
+ * The decoded values are posted as one document per response, on <data prefix>/<device id>/state.
+ * Each document has to be a json object of numbers, keyed by the sensor ids, and the batched
+ * sensors may no longer post on their own state topics, also not on a reconnect. Pass -v to see
+ * the log lines.
+ */
+#define SIMULATE_BOILER
+#define MQTT_BATCHED  true
+#include "../Intergas2MQTT.ino"
+#include <ctype.h>
+
+static int failed = 0;
+#define CHECK(cond)   do { if (!(cond)) { printf("FAILED: %s (line %d)\n", #cond, __LINE__); failed++; } } while (0)
+
+static char     document[64];       // topic of the json document
+static char     last[1024];         // the last document posted
+static uint32_t documents = 0;
+static uint32_t malformed = 0;
+static uint32_t separate = 0;       // posts on the state topic of a batched sensor
+static bool     config_ok = false;  // the discovery config of T_boiler points into the document
+
+// {"id":number,...}, with at least one member
+static bool parse(const char *json)
+{
+  const char *p = json;
+  if (*p++ != '{')
+    return false;
+  do {
+    if (*p++ != '"')
+      return false;
+    const char *key = p;
+    while (isalnum(*p) || *p == '_')
+      p++;
+    if (p == key || *p++ != '"' || *p++ != ':')
+      return false;
+    if (*p == '-')
+      p++;
+    const char *digits = p;
+    while (isdigit(*p))
+      p++;
+    if (p == digits)
+      return false;
+    if (*p == '.') {
+      digits = ++p;
+      while (isdigit(*p))
+        p++;
+      if (p == digits)
+        return false;
+    }
+  } while (*p == ',' && p++);
+  return *p++ == '}' && *p == 0;
+}
+
+static void observe(const char *topic, const char *payload, bool retained)
+{
+  if (!strcmp(topic, document)) {
+    documents++;
+    if (!parse(payload))
+      malformed++;
+    snprintf(last, sizeof(last), "%s", payload);
+    return;
+  }
+  char own[96];
+  snprintf(own, sizeof(own), "/%s/stat_t", ketel.T_boiler.uniqueId());
+  if (strlen(topic) > strlen(own) && !strcmp(topic + strlen(topic) - strlen(own), own))
+    separate++;
+  snprintf(own, sizeof(own), "/%s/config", ketel.T_boiler.uniqueId());
+  if (strstr(topic, own) && strstr(payload, document) && strstr(payload, "value_json.T_boiler"))
+    config_ok = true;
+}
+
+// loop() for the given simulated seconds
+static void run(uint32_t seconds)
+{
+  for (uint32_t ms=0; ms<seconds * 1000; ms++) {
+    loop();
+    host::advance(1000);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  host::verbose = argc > 1 && !strcmp(argv[1], "-v");
+  mqtt.observer = observe;
+  setup();
+  snprintf(document, sizeof(document), "%s/%s/state", mqtt.getDataPrefix(), ketel.getUniqueId());
+  run(600);
+  mqtt.available = false;               // after a reconnect the values go out in the document as well
+  run(60);
+  mqtt.available = true;
+  run(60);
+  CHECK(mqtt.connects == 2);
+
+  CHECK(documents > 0);
+  CHECK(malformed == 0);
+  CHECK(separate == 0);
+  CHECK(config_ok);
+
+  // the last document holds the posted values
+  char member[64];
+  int lg = snprintf(member, sizeof(member), "\"%s\":", ketel.T_boiler.uniqueId());
+  lg += ketel.T_boiler.getCurrentValue().toStr(member + lg);
+  member[lg] = 0;
+  CHECK(strstr(last, member) != NULL);
+  snprintf(member, sizeof(member), "\"%s\":", ketel.hours_on.uniqueId());
+  CHECK(strstr(last, member) != NULL);
+
+  printf("%u documents, %u posts, %u bytes\n", documents, mqtt.posts, mqtt.bytes);
+  return failed ? 1 : 0;
+}
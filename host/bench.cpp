@@ -0,0 +1,239 @@
+/*
+ * Decode time of the S? responses, the integer layout path against the float decoder of the baseline
+ *
+ * The baseline _status_1() and HAIntergasSensor::set() are copied as they were before the layout
+ * tables, only renamed, so they run next to the current code. Both post through the same stand-in
+ * of the library. The frames are taken from the simulator, so they cycle through the recorded
+ * sessions. The host has an FPU, the ESP8266 has not, so on the device floats cost relatively more
+ * than shown here.
+ *
+ * Then status() and publish() of S?, S2 and HN, over the simulator frames and over random ones,
+ * with the posts and payload bytes counted by the mock broker per frame.
+ */
+#include "HAIntergas.h"
+#include "BoilerSimulator.h"
+#include <HAMqtt.h>
+#include <ESP8266WiFi.h>
+#include <chrono>
+
+#define FRAMES  64
+#define ROUNDS  2000
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// the baseline decoder
+#define GAS_WATT  1361    // gasflow watt (1cm3 = 35.17 Joule)
+#define LOG(s)
+
+class BaselineSensor : public HASensorNumber
+{
+public:
+  BaselineSensor(const char*id, const NumberPrecision p) : HASensorNumber(id, p) {};
+  bool      set(float value, float min, float max); // sets a float when value is in between min, max
+  bool      set(uint16_t value, uint16_t min, uint16_t max); // sets a word when value is in between min, max
+};
+
+bool BaselineSensor::set(float value, float min, float max)
+{
+  if (value >= min && value <= max)
+    return setValue(value); // value is within expected limits so post the value
+
+  setCurrentValue(0.0f);    // set the current value to force a post on the first valid value
+  return false;
+}
+
+bool BaselineSensor::set(uint16_t value, uint16_t min, uint16_t max)
+{
+  if (value >= min && value <= max)
+    return setValue(value); // value is within expected limits so post the value
+
+  setCurrentValue(0);    // set the current value to force a post on the first valid value
+  return false;
+}
+
+float getfloat(uint8_t lsb, uint8_t msb) {
+  if (msb > 127)
+    return -(float((msb ^ 255) + 1) * 256 - lsb) / 100.0;
+  //else
+  return float(msb * 256 + lsb) / 100.0;
+}
+
+struct Baseline
+{
+  BaselineSensor T_boiler     { "T_boiler",     HABaseDeviceType::PrecisionP2 };
+  BaselineSensor T_boiler_out { "T_boiler_out", HABaseDeviceType::PrecisionP2 };
+  BaselineSensor T_boiler_in  { "T_boiler_in",  HABaseDeviceType::PrecisionP2 };
+  BaselineSensor T_ww_out     { "T_ww_out",     HABaseDeviceType::PrecisionP2 };
+  BaselineSensor pressure     { "pressure",     HABaseDeviceType::PrecisionP2 };
+  BaselineSensor T_set        { "T_set",        HABaseDeviceType::PrecisionP2 };
+  BaselineSensor fan_set      { "fan_set",      HABaseDeviceType::PrecisionP0 };
+  BaselineSensor fan_cur      { "fan_cur",      HABaseDeviceType::PrecisionP0 };
+  BaselineSensor fan_pwm      { "fan_pwm",      HABaseDeviceType::PrecisionP2 };
+  BaselineSensor power        { "power",        HABaseDeviceType::PrecisionP2 };
+  HASensorNumber fault_code   { "fault_code",   HABaseDeviceType::PrecisionP0 };
+  HASensorNumber last_fault   { "last_fault",   HABaseDeviceType::PrecisionP0 };
+  HABinarySensor alarm        { "alarm" };
+  HASensor       mode         { "mode" };
+  uint8_t        _bstate;
+  uint8_t        state;
+  const char    *logmsg;
+  bool           _status_1(const byte *sbuf, int lg);
+};
+
+bool Baseline::_status_1(const byte *sbuf, int lg)
+{
+  if (lg<25) {
+    logmsg = "ERROR: processing S? result -> too short";
+    return false;
+  }
+  LOG("Processing state 1 result\n");
+  bool result = true;
+
+  result &= T_boiler.set(getfloat(sbuf[ 0], sbuf[ 1]), 10.0f, 100.0f);
+  result &= T_boiler_out.set(getfloat(sbuf[ 2], sbuf[ 3]), 20.0f,  70.0f);
+  result &= T_boiler_in.set (getfloat(sbuf[ 4], sbuf[ 5]), 15.0f,  70.0f);
+  result &= T_ww_out.set(getfloat(sbuf[ 6], sbuf[ 7]), 20.0f,  70.0f);
+  result &= pressure.set(getfloat(sbuf[12], sbuf[13]),  0.0f,  5.0f);
+  result &= T_set.set(   getfloat(sbuf[14], sbuf[15]), 20.0f, 70.0f);
+  uint16_t fan= getfloat(sbuf[16], sbuf[17]) * 100;                   // target fanspeed, remember the fanspeed for boiler modus
+  result &= fan_set.set( fan,                              0,  7000); // max speed is 6500rpm for a HRE 36/48, 4600 for 28/24
+  result &= fan_cur.set( getfloat(sbuf[18], sbuf[19])*100, 0,  7000); // current fanspeed
+  result &= fan_pwm.set( getfloat(sbuf[20], sbuf[21]) *10, 0,  100);     // with a minimu setting of 20% we read 17.5
+  result &= power.set(   getfloat(sbuf[22], sbuf[23]) *GAS_WATT/1000, 0, 30); // using the io_current to estimate the gas usage in Watts
+
+  _bstate = sbuf[24];
+
+  result &= alarm.setState(sbuf[26] & (1 << 2));
+
+  if (sbuf[27] == 128)          // and what about the alarm bit?
+    result &= fault_code.setValue(sbuf[29]);      // current listed fault code is the active fault code
+  else
+  {
+    result &= last_fault.setValue(sbuf[29]);
+    result &= fault_code.setValue(0);
+  }
+  bool lock = bool(sbuf[28] & (1 << 1));
+  if (lock) {
+      result = mode.setValue("lock");
+      state = HAIntergas::LOCK;
+  }
+  else
+  {
+    switch (_bstate)
+    {
+    case 126:                     // 0x7E
+      result = mode.setValue("idle");
+      state = HAIntergas::IDLE; break;            // tempature reached, boiler in idle mode
+    case 231:                     // 0xE7
+      result = mode.setValue("spindown");
+      state = HAIntergas::SPINDOWN; break;             // spindown (nadraaien) after a burn cycle
+    case 0:
+      if (fan > 0) {    // heat is requested (Tmax>0), but are we also heating?
+        result = mode.setValue("heating");
+        state = HAIntergas::HEATING;         // yes we are heating
+      } else {
+        result = mode.setValue("standby");
+        state = HAIntergas::STANDBY;         // no, we are waiting for CV water temp to drop
+      }
+      break;
+    case 204:
+      result = mode.setValue("hot_water");
+      state = HAIntergas::HOT_WATER;   break;
+    default:
+      result = mode.setValue(("code 0x" + String(_bstate, 16)).c_str());
+      state = HAIntergas::UNKNOWN;    break;
+    }
+  }
+  if (!result)
+    logmsg = "ERROR: processing return S? command";
+
+  return result;  // return the result of posting the boiler mode
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+static uint32_t seed = 1;
+static uint32_t random32()
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+HAIntergas  device(D2);
+Baseline    baseline;
+WiFiClient  client;
+HAMqtt      mqtt(client, device, INTERGAS_SENSOR_COUNT);
+
+int main(int argc, char **argv)
+{
+  byte mac[6] = { 0x5C, 0xCF, 0x7F, 0, 0, 1 };
+  device.begin(mac, &mqtt);
+  WiFi.begin("", "");
+  delay(5000);
+  mqtt.begin("", 1883, "", "");
+  mqtt.loop();
+
+  // one frame per recorded sample
+  BoilerSimulator sim(40, 0);
+  sim.begin(9600);
+  static byte frames[FRAMES][32];
+  for (int f=0; f<FRAMES; f++) {
+    sim.print(HAIntergas::STATUS_1);
+    delay(1000);
+    if (sim.readBytes(frames[f], 32) != 32) {
+      printf("FAILED: no response from the simulator\n");
+      return 1;
+    }
+  }
+
+  typedef std::chrono::steady_clock clock;
+  auto time = [](bool (*decode)(const byte *)) {
+    uint32_t posts = mqtt.posts;
+    auto start = clock::now();
+    for (int r=0; r<ROUNDS; r++)
+      for (int f=0; f<FRAMES; f++) {
+        decode(frames[f]);
+        host::advance(1000);
+      }
+    double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / (ROUNDS * FRAMES);
+    printf(" %.0f ns/frame (%.1f posts)", ns, double(mqtt.posts - posts) / (ROUNDS * FRAMES));
+  };
+  printf("S? decode: baseline float");
+  time([](const byte *frame) { return baseline._status_1(frame, 32); });
+  printf(", integer status()");
+  time([](const byte *frame) { return device.status(frame, 32, HAIntergas::STATUS_1); });
+  printf("\n");
+
+  // per command, the recorded frames and random ones through status() and publish()
+  static const char *commands[] = { HAIntergas::STATUS_1, HAIntergas::STATUS_2, HAIntergas::STATISTICS };
+  static byte corpus[FRAMES][32], synthetic[FRAMES][32];
+  for (const char *command : commands)
+  {
+    for (int f=0; f<FRAMES; f++) {
+      sim.print(command);
+      delay(1000);
+      if (sim.readBytes(corpus[f], 32) != 32) {
+        printf("FAILED: no %c%c response from the simulator\n", command[0], command[1]);
+        return 1;
+      }
+      for (int i=0; i<32; i++)
+        synthetic[f][i] = random32();
+    }
+    for (auto set : { corpus, synthetic })
+    {
+      uint32_t posts = mqtt.posts, bytes = mqtt.bytes;
+      auto start = clock::now();
+      for (int r=0; r<ROUNDS; r++)
+        for (int f=0; f<FRAMES; f++) {
+          device.status(set[f], 32, command);
+          device.publish();
+          host::advance(1000000);
+        }
+      double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count() / (ROUNDS * FRAMES);
+      printf("%c%c %-9s %6.0f ns/frame, %5.2f posts/frame, %6.1f bytes/frame\n", command[0], command[1],
+             set == corpus ? "recorded" : "random", ns,
+             double(mqtt.posts - posts) / (ROUNDS * FRAMES), double(mqtt.bytes - bytes) / (ROUNDS * FRAMES));
+    }
+  }
+  return mqtt.isConnected() ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+/*
+ * Decodes known S?, S2 and HN responses and checks the values posted by each sensor
+ *
+ * The S? frame holds a heating sample of Protocol.txt, the S2 and HN frames values of the same
+ * boiler. The values are compared in units of the precision of their sensor, as posted. Each
+ * status flag is then decoded from a frame with only its own bit set.
+ */
+#include "HAIntergas.h"
+#include <HAMqtt.h>
+#include <ESP8266WiFi.h>
+
+static int failed = 0;
+#define CHECK(cond)   do { if (!(cond)) { printf("FAILED: %s (line %d)\n", #cond, __LINE__); failed++; } } while (0)
+#define CHECK_BASE(sensor, base)  do { int64_t v = device.sensor.getCurrentValue().getBaseValue(); \
+                                       if (v != (base)) { printf("FAILED: %s is %lld, expected %lld\n", #sensor, (long long) v, (long long) (base)); failed++; } } while (0)
+
+HAIntergas  device(D2);
+WiFiClient  client;
+HAMqtt      mqtt(client, device, INTERGAS_SENSOR_COUNT);
+
+// Central Heating, TcvI: 36.11, Tcv: 49.77, Tset: 40.00, TcvO: 40.61, TwwO: 52.93, pressure: 1.19, fan_set: 1629, fan_cur: 1657, gas: 6.24
+static const byte STATUS_1_FRAME[32] = {
+  0x71, 0x13,   0xDD, 0x0F,   0x1B, 0x0E,   0xAD, 0x14,   // T_boiler 4977, T_boiler_out 4061, T_boiler_in 3611, T_ww_out 5293
+  0x25, 0xEC,   0x25, 0xEC,   0x77, 0x00,   0xA0, 0x0F,   // NC, NC, pressure 119, T_set 4000
+  0x5D, 0x06,   0x79, 0x06,   0xC4, 0x00,   0x70, 0x02,   // fan_set 1629, fan_cur 1657, fan_pwm 196, io_curr 624
+  0x00, 0x00,   0x00, 0x00,   0x00, 0x00,   0x00, 0x00,   // heating, no flags, no fault
+};
+
+static const byte STATUS_2_FRAME[32] = {
+  0x2C, 0x01,   0x78, 0x00,   0x00, 0x00,   0xD0, 0x07,   // tap_flow 300, pump 120 (40%), T_room_set 2000
+  0xF2, 0x07,   0x00, 0x00,   0x00, 0x00,   0x00, 0x00,   // T_room_cur 2034
+  0xFF, 0xFF,   0x00, 0x00,
+};
+
+static const byte STATISTICS_FRAME[32] = {
+  0x34, 0x12,   0x2A, 0x00,   0x10, 0x27,   0xE8, 0x03,   // hours_on 0x011234 with byte 30, power_cycles 42, hours_ch 10000, hours_hw 1000
+  0x45, 0x23,   0x07, 0x00,   0x03, 0x00,   0x02, 0x00,   // burner_starts 0x012345 with byte 31, ignition_failed 7, flame_lost 3, resets 2
+  0x6F, 0x6A,   0x38, 0x03,   0x2D, 0x4D,   0x0C, 0x00,   // gas counters
+  0x2B, 0x1A,   0x89, 0x67,   0x02, 0x05,   0x01, 0x01,   // water_total 0x021A2B with byte 28, burner_starts_hw 0x056789 with byte 29
+};
+
+struct Flag {
+  uint8_t offset, bit;
+  HAIntergasFlag HAIntergas::*sensor;
+};
+static const Flag FLAGS[] = {
+  { 26, 7, &HAIntergas::gp_switch },    { 26, 6, &HAIntergas::tap_switch },   { 26, 5, &HAIntergas::roomtherm },
+  { 26, 4, &HAIntergas::pump },         { 26, 3, &HAIntergas::dwk },          { 26, 2, &HAIntergas::alarm },
+  { 26, 0, &HAIntergas::opentherm },    { 28, 7, &HAIntergas::gasvalve },     { 28, 6, &HAIntergas::spark },
+  { 28, 5, &HAIntergas::io_signal },    { 28, 3, &HAIntergas::low_pressure }, { 28, 1, &HAIntergas::burner_block },
+};
+
+int main(int argc, char **argv)
+{
+  byte mac[6] = { 0x5C, 0xCF, 0x7F, 0, 0, 1 };
+  device.begin(mac, &mqtt);
+  for (int i=0; i<HAIntergasSensor::count; i++)   // each value posted as decoded, not the mean of a window
+    HAIntergasSensor::registry[i]->setWindow(0);
+  WiFi.begin("", "");
+  delay(5000);
+  mqtt.begin("", 1883, "", "");
+  mqtt.loop();
+
+  CHECK(device.status(STATUS_1_FRAME, 32, HAIntergas::STATUS_1));
+  CHECK_BASE(T_boiler,     4977);
+  CHECK_BASE(T_boiler_out, 4061);
+  CHECK_BASE(T_boiler_in,  3611);
+  CHECK_BASE(T_ww_out,     5293);
+  CHECK_BASE(pressure,      119);
+  CHECK_BASE(T_set,        4000);
+  CHECK_BASE(fan_set,      1629);
+  CHECK_BASE(fan_cur,      1657);
+  CHECK_BASE(fan_pwm,      1960);   // 19.6 %
+  CHECK_BASE(power,         849);   // 6.24 uA * 1.361 = 8.49 kW
+  CHECK(device.state == HAIntergas::HEATING);
+
+  CHECK(device.status(STATUS_2_FRAME, 32, HAIntergas::STATUS_2));
+  CHECK_BASE(tap_flow,      300);
+  CHECK_BASE(pump_pwm,     4000);   // (200 - 120) / 2 = 40 %
+  CHECK_BASE(T_room_set,   2000);
+  CHECK_BASE(T_room_cur,   2034);
+
+  CHECK(device.status(STATISTICS_FRAME, 32, HAIntergas::STATISTICS));
+  CHECK_BASE(hours_on,         0x011234);
+  CHECK_BASE(power_cycles,     42);
+  CHECK_BASE(hours_ch,         10000);
+  CHECK_BASE(hours_hw,         1000);
+  CHECK_BASE(burner_starts,    0x012345);
+  CHECK_BASE(ignition_failed,  7);
+  CHECK_BASE(flame_lost,       3);
+  CHECK_BASE(resets,           2);
+  CHECK_BASE(water_total,      13777);    // 0x021A2B = 137771 in 1/10 l, 13.777 m3
+  CHECK_BASE(burner_starts_hw, 0x056789);
+
+  // each flag by its own bit
+  for (const Flag &f : FLAGS)
+  {
+    byte frame[32];
+    memcpy(frame, STATUS_1_FRAME, sizeof(frame));
+    frame[f.offset] = 1 << f.bit;
+    device.status(frame, 32, HAIntergas::STATUS_1);
+    for (const Flag &g : FLAGS)
+      if ((device.*g.sensor).getCurrentState() != (&g == &f)) {
+        printf("FAILED: byte %d bit %d, %s is %s\n", f.offset, f.bit, (device.*g.sensor).uniqueId(), &g == &f ? "off" : "on");
+        failed++;
+      }
+  }
+
+  printf("%d checks failed\n", failed);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * Feeds random, truncated and corrupted responses to the decoders, built with ASan and UBSan
+ *
+ * Each buffer is copied to a heap block of exactly its length, so any read beyond it is caught.
+ * Buffers shorter than a response must be rejected. Last the simulator corrupts its responses,
+ * which then go through the link into the decoders as the sketch would.
+ */
+#include "HAIntergas.h"
+#include "BoilerLink.h"
+#include "BoilerSimulator.h"
+#include <HAMqtt.h>
+#include <ESP8266WiFi.h>
+
+#define ROUNDS  20000
+
+static int failed = 0;
+#define CHECK(cond)   do { if (!(cond)) { printf("FAILED: %s (line %d)\n", #cond, __LINE__); failed++; } } while (0)
+
+HAIntergas  device(D2);
+WiFiClient  client;
+HAMqtt      mqtt(client, device, INTERGAS_REGISTRY);
+
+static const char *COMMANDS[] = { HAIntergas::STATUS_1, HAIntergas::STATUS_2, HAIntergas::STATISTICS,
+                                  HAIntergas::PROD_CODE, HAIntergas::PARAMS, HAIntergas::SETTINGS };
+static const int   MINIMUM[]  = { 30, 20, 24, 4, 4, 4 };   // shorter responses are rejected
+
+static uint32_t seed = 1;
+static uint32_t random32()
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+// decode a copy of exactly lg bytes, returns whether it was accepted
+static bool decode(const byte *frame, int lg, int c)
+{
+  byte *copy = new byte[lg ? lg : 1];
+  memcpy(copy, frame, lg);
+  bool accepted = device.status(lg ? copy : NULL, lg, COMMANDS[c]);
+  delete[] copy;
+  if (accepted && lg < MINIMUM[c]) {
+    printf("FAILED: %c%c accepted %d bytes\n", COMMANDS[c][0], COMMANDS[c][1], lg);
+    failed++;
+  }
+  return accepted;
+}
+
+int main(int argc, char **argv)
+{
+  byte mac[6] = { 0x5C, 0xCF, 0x7F, 0, 0, 1 };
+  device.begin(mac, &mqtt);
+  WiFi.begin("", "");
+  delay(5000);
+  mqtt.begin("", 1883, "", "");
+  mqtt.loop();
+
+  // random buffers of random length
+  byte frame[BOILER_LINK_BUFFER];
+  uint32_t frames = 0;
+  for (int r=0; r<ROUNDS; r++)
+    for (int c=0; c<6; c++) {
+      int lg = random32() % (BOILER_LINK_BUFFER + 1);
+      for (int i=0; i<lg; i++)
+        frame[i] = random32();
+      decode(frame, lg, c);
+      host::advance(100000);
+      frames++;
+    }
+
+  // each valid response, and all of its truncations
+  BoilerSimulator sim(40, 0);
+  sim.begin(9600);
+  for (int c=0; c<6; c++) {
+    sim.print(COMMANDS[c]);
+    delay(1000);
+    int lg = sim.readBytes(frame, sizeof(frame));
+    CHECK(lg >= MINIMUM[c]);
+    for (int cut=lg; cut>=0; cut--, frames++)
+      decode(frame, cut, c);
+  }
+
+  // corrupted responses through the link
+  BoilerLink link(sim);
+  sim.fuzz = 30;
+  uint32_t completed = 0;
+  for (int r=0; r<3000; r++) {
+    int c = r % 3;
+    link.send(COMMANDS[c], 300, 1, 32);
+    BoilerLink::State state;
+    while ((state = link.loop()) == BoilerLink::BUSY)
+      host::advance(1000);
+    if (state == BoilerLink::COMPLETE) {
+      decode(link.frame(), link.length(), c);
+      completed++;
+    }
+  }
+  CHECK(sim.corrupted > 0 && completed > 0);
+
+  printf("%u random and truncated frames, %u corrupted responses, %u complete\n", frames, sim.corrupted, completed);
+  return failed ? 1 : 0;
+}
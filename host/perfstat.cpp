@@ -0,0 +1,33 @@
+/*
+ * The percentiles of PerfStat, also when more values are added than a bucket can count
+ */
+#include "PerfStat.h"
+
+static int failed = 0;
+#define CHECK(cond)   do { if (!(cond)) { printf("FAILED: %s (line %d)\n", #cond, __LINE__); failed++; } } while (0)
+
+int main(int argc, char **argv)
+{
+  PerfStat stat;
+  for (int i=0; i<100; i++)
+    stat.add(i < 95 ? 10 : 1000);
+  CHECK(stat.percentile(95) == 11);     // upper bound of the bucket of 10
+  CHECK(stat.percentile(99) == 1000);
+  CHECK(stat.count() == 100);
+
+  stat.reset();                         // 1% slow, far beyond the 65535 of a bucket
+  for (int i=0; i<1000000; i++)
+    stat.add(i % 100 ? 10 : 1000);
+  CHECK(stat.percentile(95) == 11);
+  CHECK(stat.percentile(99) == 11);
+  CHECK(stat.percentile(100) == 1000);
+  CHECK(stat.max() == 1000);
+  CHECK(stat.count() == 1000000);
+
+  char json[96];
+  stat.toJson(json, sizeof(json));
+  CHECK(!strcmp(json, "{\"min\":10,\"avg\":19,\"max\":1000,\"p95\":11,\"n\":1000000}"));
+
+  printf("%d checks failed\n", failed);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * Replays the sessions of Protocol.txt with pipelined set, and follows the commands sent
+ *
+ * S? and S2 have to alternate back-to-back, HN goes in between when due, and the boiler gets at
+ * least min_gap after each response before the next command. Pass -v to see the log lines.
+ */
+#define SIMULATE_BOILER
+#define PIPELINED     true
+#include "../Intergas2MQTT.ino"
+
+static int failed = 0;
+#define CHECK(cond)   do { if (!(cond)) { printf("FAILED: %s (line %d)\n", #cond, __LINE__); failed++; } } while (0)
+
+static char     previous[4];        // the previous S? or S2
+static uint32_t sent = 0;
+static uint32_t repeated = 0;       // S? after S?, or S2 after S2
+static int32_t  shortest = INT32_MAX;
+
+static void observe(const char *command, int32_t idle)
+{
+  if (sent++)                       // the first command follows no response
+    shortest = min(shortest, idle);
+  if (strcmp(command, "S?\r") && strcmp(command, "S2\r"))
+    return;
+  if (!strcmp(command, previous))
+    repeated++;
+  strcpy(previous, command);
+}
+
+// loop() for the given simulated seconds
+static void run(uint32_t seconds)
+{
+  for (uint32_t ms=0; ms<seconds * 1000; ms++) {
+    loop();
+    host::advance(1000);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  host::verbose = argc > 1 && !strcmp(argv[1], "-v");
+  wemos_serial.observer = observe;
+  setup();
+  run(600);
+
+  CHECK(repeated == 0);
+  CHECK(shortest >= min_gap * 1000);
+  CHECK(wemos_serial.answered[0] > 600 * 2);     // far more than once a second
+  CHECK(wemos_serial.answered[1] > 600 * 2);
+  CHECK(wemos_serial.answered[2] >= 600 / 300 - 1);
+  CHECK(diag.commands > 0 || HAIntergasSensor::publishes > 0);
+
+  printf("%u commands, S? %u, S2 %u, HN %u, shortest gap %d us\n", sent,
+         wemos_serial.answered[0], wemos_serial.answered[1], wemos_serial.answered[2], shortest);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * Maps the DS18B20 probes to their roles, with a probe which does not give its address
+ *
+ * The unreadable probe may not end up in a role, nor in the stored map. Once readable again
+ * it takes the role left open, without moving the others.
+ */
+#include "HAIntergas.h"
+#include <HAMqtt.h>
+#include <EEPROM.h>
+
+static int failed = 0;
+#define CHECK(cond)   do { if (!(cond)) { printf("FAILED: %s (line %d)\n", #cond, __LINE__); failed++; } } while (0)
+
+HAIntergas  device(D2);
+WiFiClient  client;
+HAMqtt      mqtt(client, device, INTERGAS_SENSOR_COUNT);
+
+int main(int argc, char **argv)
+{
+  byte mac[6] = { 0x5C, 0xCF, 0x7F, 0, 0, 1 };
+  static const DeviceAddress none = { 0 };
+
+  DallasTemperature::unreadable = 3;
+  CHECK(!device.begin(mac, &mqtt));
+  CHECK(strstr(device.found(), "mixed") && !strstr(device.found(), "CV-in"));
+  const uint8_t *stored = EEPROM.getConstDataPtr() + PERSIST_PROBES + 2;
+  CHECK(memcmp(stored + 7 * sizeof(DeviceAddress), none, sizeof(none)) == 0);   // CV-in has no probe
+  for (int i=0; i<7; i++)
+    CHECK(memcmp(stored + i * sizeof(DeviceAddress), DallasTemperature::bus[i < 3 ? i : i + 1].address, sizeof(DeviceAddress)) == 0);
+  CHECK(memcmp(device.cv_in.getAddress(), none, sizeof(none)) == 0);
+
+  DallasTemperature::unreadable = -1;   // the next boot
+  CHECK(device.begin(mac, &mqtt));
+  CHECK(!strcmp(device.found(), "New DS probes: CV-in"));
+  CHECK(memcmp(device.cv_in.getAddress(), DallasTemperature::bus[3].address, sizeof(DeviceAddress)) == 0);
+  CHECK(memcmp(device.mixed.getAddress(), DallasTemperature::bus[5].address, sizeof(DeviceAddress)) == 0);
+
+  uint32_t searches = DallasTemperature::searches;
+  CHECK(device.begin(mac, &mqtt));      // all probes respond, no bus search
+  CHECK(DallasTemperature::searches == searches && !*device.found());
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Replays the sessions of Protocol.txt through the whole sketch, on a simulated clock
+ *
+ * Runs setup() and loop() with 1ms steps: the boiler is polled through the simulator, the values
+ * are decoded and posted to the stand-in broker. Halfway the broker goes down for a while, so
+ * the history and the reconnect are covered as well. At the end both http pages are scraped.
+ * Pass -v to see the log lines.
+ */
+#define SIMULATE_BOILER
+#include "../Intergas2MQTT.ino"
+
+static int failed = 0;
+#define CHECK(cond)   do { if (!(cond)) { printf("FAILED: %s (line %d)\n", #cond, __LINE__); failed++; } } while (0)
+
+static uint64_t longest = 0;            // us of simulated time spent in one loop(), as in delay()
+
+static uint32_t drained = 0;            // history lines posted
+
+static void observe(const char *topic, const char *payload, bool retained)
+{
+  if (!strcmp(topic, "Intergas/history"))
+    for (drained++; *payload; payload++)
+      drained += *payload == '\n';
+}
+
+// loop() for the given simulated seconds
+static void run(uint32_t seconds)
+{
+  for (uint32_t ms=0; ms<seconds * 1000; ms++) {
+    uint64_t start = host::now_us;
+    loop();
+    longest = max(longest, host::now_us - start);
+    host::advance(1000);
+  }
+}
+
+// requests uri, it is served once no boiler is busy
+static void scrape(const char *uri)
+{
+  ESP8266WebServer::get(uri);
+  for (int ms=0; ms<60000 && !ESP8266WebServer::code; ms++) {
+    loop();
+    host::advance(1000);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  host::verbose = argc > 1 && !strcmp(argv[1], "-v");
+  mqtt.observer = observe;
+  setup();
+  run(600);
+  CHECK(mqtt.connects == 1);
+  CHECK(led.blinks > 0);
+  CHECK(mqtt.configs > 0 && mqtt.configs < mqtt.posts);
+  CHECK(HAIntergasSensor::rejected == 0);   // the recorded values are all valid
+  CHECK(burst.bursts > 0);
+  CHECK(longest == 0);                  // loop() never waits, the clock is synchronized in the background
+
+  uint32_t polls = led.blinks, posts = mqtt.posts;
+  mqtt.available = false;               // the broker goes down, the values end up in the history
+  run(300);
+  CHECK(led.blinks > polls);
+  CHECK(mqtt.posts == posts);
+  CHECK(history.count() > 0);
+
+  uint32_t stored = history.count(), lost = history.dropped, configs = mqtt.configs;
+  mqtt.available = true;                // and is back, the history is drained
+  mqtt.failing = 200;                   // while the first posts fail
+  run(300);
+  CHECK(mqtt.connects == 2);
+  CHECK(mqtt.configs == configs);       // unchanged, so not posted again
+  CHECK(history.count() == 0);
+  CHECK(history.dropped == lost);
+  CHECK(drained >= stored);             // nothing lost to the failed posts
+
+  // a value stuck out of range starts one burst, and S2 and HN keep being polled
+  uint32_t bursts = burst.bursts, answered[3];
+  memcpy(answered, wemos_serial.answered, sizeof(answered));
+  wemos_serial.stuck = 2;               // T_boiler_out at 18.00, below its range
+  wemos_serial.stuck_value = 1800;
+  run(600);
+  wemos_serial.stuck = -1;
+  CHECK(burst.bursts - bursts <= 600 / (20 + 60) + 1);   // a burst lasts 20s, and a minute in between
+  CHECK(wemos_serial.answered[1] - answered[1] >= 600 / 30 - 1);   // at least as often as the slowest
+  CHECK(wemos_serial.answered[2] - answered[2] >= 600 / 300 - 1);  // interval of S2 and HN
+
+  scrape("/metrics");                   // the latest values over http
+  CHECK(ESP8266WebServer::code == 200);
+  CHECK(strstr(ESP8266WebServer::response, "intergas_frame_age_ms{boiler=\"0\",command=\"S?\"}") != NULL);
+  CHECK(strstr(ESP8266WebServer::response, "frame=") == NULL);   // the frame bytes would be a new series each frame
+  char line[96];                        // the snapshot of the last decoded frame
+  int lg = snprintf(line, sizeof(line), "intergas_value{sensor=\"%s\"} ", ketel.T_boiler.uniqueId());
+  lg += ketel.T_boiler.getCurrentValue().toStr(line + lg);
+  strcpy(line + lg, "\n");
+  CHECK(strstr(ESP8266WebServer::response, line) != NULL);
+
+  scrape("/json");                      // which has the raw frames as well
+  CHECK(ESP8266WebServer::code == 200);
+  CHECK(strstr(ESP8266WebServer::response, "\"S?\":{\"age\":") != NULL);
+
+  // the meter is set back, once, also when the command was retained
+  HAIntergas &device = boilers[0].device;
+  mqtt.inject("Intergas/calibrate/0", "cv 100.00", true);
+  CHECK(device.calibration.cv_base == 10000);
+  CHECK(mqtt.retained("Intergas/calibrate/0") == NULL);
+  run(60);
+  CHECK(device.energy_cv.getCurrentValue().getBaseValue() < 11000);
+  mqtt.available = false;
+  run(10);
+  device.calibration.cv_base = 0;       // would be undone if the command were delivered again
+  mqtt.available = true;
+  run(10);
+  CHECK(mqtt.connects == 3);
+  CHECK(device.calibration.cv_base == 0);
+  CHECK(!device.calibrate("hw 21474837.00"));   // would overflow the 1/100 m3
+  CHECK(!device.calibrate("factor 99999999999"));
+  CHECK(device.calibrate("hw 9999999.99") && device.calibration.hw_base == 999999999);
+
+  printf("%u posts, %u bytes, %u configs, %u values suppressed, %u rejected\n",
+         mqtt.posts, mqtt.bytes, mqtt.configs, HAIntergasSensor::suppressed, HAIntergasSensor::rejected);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#include "Arduino.h"
+#include <time.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// simulated time
+////////////////////////////////////////////////////////////////////////////////////////////
+uint64_t host::now_us = 0;
+
+void host::advance(uint32_t us) {
+  now_us += us;
+}
+
+uint32_t millis() { return host::now_us / 1000; }
+uint32_t micros() { return host::now_us; }
+void delay(uint32_t ms) { host::advance(ms * 1000); }
+void yield() {}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// SNTP answers a second after being configured, with march 6, 2023 as the start of the replay
+////////////////////////////////////////////////////////////////////////////////////////////
+#define HOST_EPOCH  1678104000UL
+static uint64_t sntp_started = 0;
+static bool     sntp = false;
+
+void configTime(const char *tz, const char *server1, const char *server2, const char *server3)
+{
+  setenv("TZ", tz, 1);
+  tzset();
+  sntp = true;
+  sntp_started = host::now_us;
+}
+
+// replaces the one of libc, as the sketch polls time() until SNTP has set it
+extern "C" time_t time(time_t *t) noexcept
+{
+  time_t now = host::now_us / 1000000;
+  if (sntp && host::now_us - sntp_started >= 1000000)
+    now = HOST_EPOCH + (host::now_us - sntp_started) / 1000000;
+  if (t)
+    *t = now;
+  return now;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////
+String::String(int value, unsigned char base)
+: String()
+{
+  char s[34];
+  if (base == 16)
+    snprintf(s, sizeof(s), "%x", value);
+  else
+    snprintf(s, sizeof(s), "%d", value);
+  *this = s;
+}
+
+String operator+(const char *s, const String &other)
+{
+  char *joined = new char[strlen(s) + other.length() + 1];
+  strcat(strcpy(joined, s), other._s);
+  String result(joined);
+  delete[] joined;
+  return result;
+}
+
+String IPAddress::toString() const
+{
+  char s[16];
+  snprintf(s, sizeof(s), "%u.%u.%u.%u", _ip[0], _ip[1], _ip[2], _ip[3]);
+  return String(s);
+}
+
+EspClass ESP;
+
+uint32_t EspClass::getFreeHeap()         { return 40000; }
+uint32_t EspClass::getMaxFreeBlockSize() { return 30000; }
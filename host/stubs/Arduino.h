@@ -0,0 +1,82 @@
+/*
+ * Stand-in for the ESP8266 Arduino core, just enough to build the sketch on Linux
+ *
+ * Time is simulated: millis() and micros() only move when the harness advances the clock,
+ * so a replay runs as fast as the host allows and gives the same result each run.
+ */
+#ifndef HOST_ARDUINO
+#define HOST_ARDUINO
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+
+typedef uint8_t byte;
+using std::min;
+using std::max;
+
+#define PROGMEM
+#define memcpy_P  memcpy
+#define strcpy_P  strcpy
+#define strlen_P  strlen
+
+class __FlashStringHelper;
+#define F(s)      (reinterpret_cast<const __FlashStringHelper *>(s))
+
+enum { D0 = 16, D1 = 5, D2 = 4, D3 = 0, D4 = 2, D5 = 14, D6 = 12, D7 = 13, D8 = 15, RX = 3, TX = 1 };
+
+uint32_t millis();
+uint32_t micros();
+void     delay(uint32_t ms);
+void     yield();
+
+// the clock of the harness
+namespace host {
+  extern uint64_t now_us;
+  void advance(uint32_t us);
+}
+
+// allocates on the heap as the one of the core does, so the allocation check sees it
+class String
+{
+private:
+  char *_s;
+public:
+  String(const char *s = "") : _s(strcpy(new char[strlen(s) + 1], s)) {};
+  String(const String &other) : String(other._s) {};
+  String(int value, unsigned char base = 10);
+  String &operator=(const String &other) { if (this != &other) { delete[] _s; _s = strcpy(new char[strlen(other._s) + 1], other._s); } return *this; };
+  String &operator=(const char *s) { return *this = String(s); };
+  ~String() { delete[] _s; };
+  const char *c_str() const { return _s; };
+  unsigned int length() const { return strlen(_s); };
+  bool isEmpty() const { return !_s[0]; };
+  void clear() { *this = ""; };
+  friend String operator+(const char *s, const String &other);
+};
+
+class IPAddress
+{
+private:
+  uint8_t _ip[4];
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : _ip{a, b, c, d} {};
+  String toString() const;
+};
+
+class EspClass
+{
+public:
+  uint32_t getFreeHeap();
+  uint32_t getMaxFreeBlockSize();
+};
+extern EspClass ESP;
+
+void configTime(const char *tz, const char *server1, const char *server2 = nullptr, const char *server3 = nullptr);
+
+#endif
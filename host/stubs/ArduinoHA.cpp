@@ -0,0 +1,448 @@
+#include <HAMqtt.h>
+#include <HADevice.h>
+#include <device-types/HASensorNumber.h>
+#include <device-types/HABinarySensor.h>
+#include <utils/HASerializer.h>
+#include <utils/HADictionary.h>
+
+const char HANameProperty[]              = "name";
+const char HAUniqueIdProperty[]          = "uniq_id";
+const char HADeviceClassProperty[]       = "dev_cla";
+const char HAStateClassProperty[]        = "stat_cla";
+const char HAIconProperty[]              = "ic";
+const char HAUnitOfMeasurementProperty[] = "unit_of_meas";
+const char HAStateTopic[]                = "stat_t";
+const char HAConfigTopic[]               = "config";
+
+#define STR(f)  (reinterpret_cast<const char *>(f))
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// HANumeric
+////////////////////////////////////////////////////////////////////////////////////////////
+static const int64_t FACTOR[] = { 1, 10, 100, 1000 };
+
+HANumeric::HANumeric(float value, uint8_t precision)
+: _isSet(true), _value(llroundf(value * FACTOR[precision])), _precision(precision)
+{
+}
+
+float HANumeric::toFloat() const
+{
+  return float(_value) / FACTOR[_precision];
+}
+
+uint16_t HANumeric::toStr(char *dst) const
+{
+  char s[32];
+  int64_t v = _value < 0 ? -_value : _value;
+  int lg;
+  if (_precision == 0)
+    lg = snprintf(s, sizeof(s), "%s%lld", _value < 0 ? "-" : "", (long long) v);
+  else
+    lg = snprintf(s, sizeof(s), "%s%lld.%0*lld", _value < 0 ? "-" : "", (long long) (v / FACTOR[_precision]),
+                  (int) _precision, (long long) (v % FACTOR[_precision]));
+  memcpy(dst, s, lg);
+  return lg;
+}
+
+uint16_t HANumeric::calculateSize() const
+{
+  char s[32];
+  return toStr(s);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// HADevice
+////////////////////////////////////////////////////////////////////////////////////////////
+bool HADevice::setUniqueId(const byte *uniqueId, uint16_t length)
+{
+  if (_uniqueId[0] || length * 2 >= sizeof(_uniqueId))
+    return false;
+  for (int i=0; i<length; i++)
+    sprintf(_uniqueId + 2*i, "%02x", uniqueId[i]);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// HASerializer
+////////////////////////////////////////////////////////////////////////////////////////////
+HASerializer::HASerializer(HABaseDeviceType *deviceType, uint8_t maxEntriesNb)
+: _owner(deviceType), _entries(new Entry[maxEntriesNb]), _count(0), _max(maxEntriesNb)
+{
+}
+
+HASerializer::~HASerializer()
+{
+  delete[] _entries;
+}
+
+void HASerializer::set(const __FlashStringHelper *property, const void *value, PropertyValueType type)
+{
+  if (!property || !value || _count >= _max)
+    return;                   // as the library does, no value no entry
+  _entries[_count++] = { PropertyEntry, STR(property), (const char *) value, WithDevice };
+}
+
+void HASerializer::set(FlagType flag)
+{
+  if (_count < _max)
+    _entries[_count++] = { FlagEntry, NULL, NULL, flag };
+}
+
+void HASerializer::topic(const __FlashStringHelper *topic)
+{
+  if (_count < _max)
+    _entries[_count++] = { TopicEntry, STR(topic), NULL, WithDevice };
+}
+
+int HASerializer::render(char *dst, int size) const
+{
+  HAMqtt *mqtt = HAMqtt::instance();
+  const char *device = mqtt->getDevice()->getUniqueId();
+  int pos = snprintf(dst, size, "{");
+  for (int i=0; i<_count && pos < size; i++)
+  {
+    const Entry &e = _entries[i];
+    const char *sep = i ? "," : "";
+    if (e.type == PropertyEntry)
+      pos += snprintf(dst + pos, size - pos, "%s\"%s\":\"%s\"", sep, e.property, e.value);
+    else if (e.type == TopicEntry)
+      pos += snprintf(dst + pos, size - pos, "%s\"%s\":\"%s/%s/%s/%s\"", sep, e.property,
+                      mqtt->getDataPrefix(), device, _owner->uniqueId(), e.property);
+    else if (e.flag == WithUniqueId)
+      pos += snprintf(dst + pos, size - pos, "%s\"uniq_id\":\"%s_%s\"", sep, device, _owner->uniqueId());
+    else if (e.flag == WithDevice)
+      pos += snprintf(dst + pos, size - pos, "%s\"dev\":{\"ids\":\"%s\"}", sep, device);
+    else
+      pos += snprintf(dst + pos, size - pos, "%s\"avty_t\":\"%s/%s/avty_t\"", sep, mqtt->getDataPrefix(), device);
+  }
+  if (pos < size)
+    pos += snprintf(dst + pos, size - pos, "}");
+  return pos < size ? pos : size - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// device types
+////////////////////////////////////////////////////////////////////////////////////////////
+HABaseDeviceType::HABaseDeviceType(const __FlashStringHelper *componentName, const char *uniqueId)
+: _componentName(STR(componentName)), _uniqueId(uniqueId), _name(NULL), _serializer(NULL)
+{
+}
+
+HAMqtt *HABaseDeviceType::mqtt()
+{
+  return HAMqtt::instance();
+}
+
+void HABaseDeviceType::destroySerializer()
+{
+  delete _serializer;
+  _serializer = NULL;
+}
+
+void HABaseDeviceType::publishConfig()
+{
+  buildSerializer();
+  if (!_serializer)
+    return;
+
+  char topic[128], config[1024];
+  snprintf(topic, sizeof(topic), "%s/%s/%s/%s/config", mqtt()->getDiscoveryPrefix(), _componentName,
+           mqtt()->getDevice()->getUniqueId(), _uniqueId);
+  _serializer->render(config, sizeof(config));
+  mqtt()->publish(topic, config, true);
+  mqtt()->configs++;
+  destroySerializer();
+}
+
+bool HABaseDeviceType::publishOnDataTopic(const __FlashStringHelper *topic, const char *value, bool retained)
+{
+  if (!value)
+    return false;
+  char t[128];
+  snprintf(t, sizeof(t), "%s/%s/%s/%s", mqtt()->getDataPrefix(), mqtt()->getDevice()->getUniqueId(), _uniqueId, STR(topic));
+  return mqtt()->publish(t, value, retained);
+}
+
+void HASensor::buildSerializer()
+{
+  if (_serializer || !uniqueId())
+    return;
+  _serializer = new HASerializer(this, 10);
+  _serializer->set(AHATOFSTR(HANameProperty), getName());
+  _serializer->set(HASerializer::WithUniqueId);
+  _serializer->set(AHATOFSTR(HADeviceClassProperty), _class);
+  _serializer->set(AHATOFSTR(HAStateClassProperty), _state_class);
+  _serializer->set(AHATOFSTR(HAIconProperty), _icon);
+  _serializer->set(AHATOFSTR(HAUnitOfMeasurementProperty), _unit);
+  _serializer->topic(AHATOFSTR(HAStateTopic));
+  _serializer->set(HASerializer::WithDevice);
+  _serializer->set(HASerializer::WithAvailability);
+}
+
+void HASensor::onMqttConnected()
+{
+  if (uniqueId())
+    publishConfig();
+}
+
+bool HASensor::setValue(const char *value)
+{
+  return publishOnDataTopic(AHATOFSTR(HAStateTopic), value, true);
+}
+
+bool HASensorNumber::publishValue(const HANumeric &value)
+{
+  if (!value.isSet())
+    return false;
+  char s[32];
+  s[value.toStr(s)] = 0;
+  return publishOnDataTopic(AHATOFSTR(HAStateTopic), s, true);
+}
+
+// as the library does, the current value is only updated once it is posted
+bool HASensorNumber::setValue(const HANumeric &value, bool force)
+{
+  if (!force && value == _currentValue)
+    return true;
+  if (!publishValue(value))
+    return false;
+  _currentValue = value;
+  return true;
+}
+
+void HASensorNumber::onMqttConnected()
+{
+  HASensor::onMqttConnected();
+  publishValue(_currentValue);
+}
+
+void HABinarySensor::buildSerializer()
+{
+  if (_serializer || !uniqueId())
+    return;
+  _serializer = new HASerializer(this, 8);
+  _serializer->set(AHATOFSTR(HANameProperty), getName());
+  _serializer->set(HASerializer::WithUniqueId);
+  _serializer->set(AHATOFSTR(HADeviceClassProperty), _class);
+  _serializer->set(AHATOFSTR(HAIconProperty), _icon);
+  _serializer->topic(AHATOFSTR(HAStateTopic));
+  _serializer->set(HASerializer::WithDevice);
+  _serializer->set(HASerializer::WithAvailability);
+}
+
+bool HABinarySensor::publishState(bool state)
+{
+  return publishOnDataTopic(AHATOFSTR(HAStateTopic), state ? "ON" : "OFF", true);
+}
+
+bool HABinarySensor::setState(bool state, bool force)
+{
+  if (!force && state == _currentState)
+    return true;
+  if (!publishState(state))
+    return false;
+  _currentState = state;
+  return true;
+}
+
+void HABinarySensor::onMqttConnected()
+{
+  if (!uniqueId())
+    return;
+  publishConfig();
+  publishState(_currentState);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// HAMqtt
+////////////////////////////////////////////////////////////////////////////////////////////
+HAMqtt *HAMqtt::_instance = NULL;
+
+HAMqtt::HAMqtt(WiFiClient &client, HADevice &device, uint8_t maxDevicesTypesNb)
+: _device(device), _types(new HABaseDeviceType*[maxDevicesTypesNb]), _count(0), _max(maxDevicesTypesNb),
+  _begun(false), _connected(false), _onConnected(NULL), _onMessage(NULL), _subscriptions(0), _length(0), _retain(false),
+  available(true), posts(0), configs(0), bytes(0), connects(0), failing(0), observer(NULL)
+{
+  memset(_retained, 0, sizeof(_retained));
+  memset(_buffer, 0, sizeof(_buffer));
+  _instance = this;
+}
+
+bool HAMqtt::begin(const char *server, uint16_t port, const char *user, const char *password)
+{
+  _begun = true;
+  return true;
+}
+
+void HAMqtt::addDeviceType(HABaseDeviceType *type)
+{
+  if (_count < _max)
+    _types[_count++] = type;
+}
+
+// single level wildcards only, as used by the sketch
+static bool topic_matches(const char *filter, const char *topic)
+{
+  while (*filter && *topic)
+  {
+    if (*filter == '+') {
+      while (*topic && *topic != '/')
+        topic++;
+      filter++;
+      continue;
+    }
+    if (*filter++ != *topic++)
+      return false;
+  }
+  return !*filter && !*topic;
+}
+
+bool HAMqtt::_matches(const char *topic) const
+{
+  for (int i=0; i<_subscriptions; i++)
+    if (topic_matches(_subscribed[i], topic))
+      return true;
+  return false;
+}
+
+void HAMqtt::_retain_post(const char *topic, const char *payload, uint16_t length)
+{
+  if (strlen(topic) >= HOST_MQTT_TOPIC || length >= HOST_MQTT_PAYLOAD)
+    return;
+  Retained *free = NULL;
+  for (Retained &r : _retained)
+  {
+    if (!strcmp(r.topic, topic)) {
+      free = &r;
+      break;
+    }
+    if (!free && !r.topic[0])
+      free = &r;
+  }
+  if (!free)
+    return;
+  if (!length) {              // an empty retained post clears the topic
+    free->topic[0] = 0;
+    return;
+  }
+  strcpy(free->topic, topic);
+  memcpy(free->payload, payload, length);
+  free->payload[length] = 0;
+  free->length = length;
+}
+
+const char *HAMqtt::retained(const char *topic) const
+{
+  for (const Retained &r : _retained)
+    if (r.topic[0] && !strcmp(r.topic, topic))
+      return r.payload;
+  return NULL;
+}
+
+void HAMqtt::_connect()
+{
+  _connected = true;
+  connects++;
+  if (_onConnected)
+    _onConnected();
+  for (int i=0; i<_count; i++)
+    _types[i]->onMqttConnected();
+}
+
+void HAMqtt::loop()
+{
+  bool reachable = _begun && available && WiFi.isConnected();
+  if (_connected && !reachable)
+    _connected = false;
+  else if (!_connected && reachable)
+    _connect();
+}
+
+bool HAMqtt::subscribe(const char *topic)
+{
+  if (!_connected)
+    return false;
+  bool known = false;
+  for (int i=0; i<_subscriptions; i++)
+    known |= !strcmp(_subscribed[i], topic);
+  if (!known && _subscriptions < 4)
+    strcpy(_subscribed[_subscriptions++], topic);
+
+  for (const Retained &r : _retained)   // the broker delivers the retained posts on subscribing
+    if (r.topic[0] && topic_matches(topic, r.topic))
+      _deliver(r.topic, r.payload, r.length);
+  return true;
+}
+
+void HAMqtt::_deliver(const char *topic, const char *payload, uint16_t length)
+{
+  if (!_onMessage || strlen(topic) >= HOST_MQTT_TOPIC || length >= HOST_MQTT_PAYLOAD)
+    return;
+  char *t = _buffer + 4;                // behind the fixed header and the topic length
+  strcpy(t, topic);
+  char *p = t + strlen(t) + 1;
+  memcpy(p, payload, length);
+  p[length] = 0;
+  _onMessage(t, (const uint8_t *) p, length);
+}
+
+bool HAMqtt::publish(const char *topic, const char *payload, bool retained)
+{
+  if (!_connected)
+    return false;
+  if (failing) {
+    failing--;
+    return false;
+  }
+  // the topic is copied into the packet byte by byte, a topic delivered from the same buffer is
+  // overwritten while it is read, as with PubSubClient
+  char *packet = _buffer + 7;
+  int lg = 0;
+  while (topic[lg] && lg < HOST_MQTT_TOPIC - 1) {
+    packet[lg] = topic[lg];
+    lg++;
+  }
+  packet[lg] = 0;
+  topic = packet;
+  posts++;
+  bytes += strlen(payload);
+  if (observer)
+    observer(topic, payload, retained);
+  if (retained && (_matches(topic) || this->retained(topic)))
+    _retain_post(topic, payload, strlen(payload));
+  return true;
+}
+
+bool HAMqtt::beginPublish(const char *topic, uint16_t length, bool retained)
+{
+  if (!_connected || strlen(topic) >= HOST_MQTT_TOPIC)
+    return false;
+  strcpy(_topic, topic);
+  _length = length;
+  _retain = retained;
+  return true;
+}
+
+bool HAMqtt::writePayload(const char *data, uint16_t length)
+{
+  return _connected && length <= _length;
+}
+
+bool HAMqtt::endPublish()
+{
+  if (!_connected)
+    return false;
+  posts++;
+  bytes += _length;
+  return true;
+}
+
+void HAMqtt::inject(const char *topic, const char *payload, bool retained)
+{
+  uint16_t length = strlen(payload);
+  if (retained)
+    _retain_post(topic, payload, length);
+  if (_connected && _matches(topic))
+    _deliver(topic, payload, length);
+}
@@ -0,0 +1,32 @@
+/*
+ * Stand-in for the over the air updates, which never come on the host
+ */
+#ifndef HOST_ARDUINO_OTA
+#define HOST_ARDUINO_OTA
+
+#include <Arduino.h>
+
+typedef enum {
+  OTA_AUTH_ERROR,
+  OTA_BEGIN_ERROR,
+  OTA_CONNECT_ERROR,
+  OTA_RECEIVE_ERROR,
+  OTA_END_ERROR,
+} ota_error_t;
+
+class ArduinoOTAClass
+{
+public:
+  void setPort(uint16_t port) {};
+  void setHostname(const char *name) {};
+  void setPassword(const char *password) {};
+  void onStart(std::function<void(void)> fn) {};
+  void onEnd(std::function<void(void)> fn) {};
+  void onProgress(std::function<void(unsigned int, unsigned int)> fn) {};
+  void onError(std::function<void(ota_error_t)> fn) {};
+  void begin() {};
+  void handle() {};
+};
+extern ArduinoOTAClass ArduinoOTA;
+
+#endif
@@ -0,0 +1,55 @@
+#include "Clock.h"
+#include <time.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// civil dates from and to days since 1970, after Howard Hinnant
+////////////////////////////////////////////////////////////////////////////////////////////
+DateTime::DateTime(uint32_t t)
+: _unix(t)
+{
+  int32_t z = t / 86400 + 719468;
+  int32_t era = z / 146097;
+  uint32_t doe = z - era * 146097;
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  _day = doy - (153 * mp + 2) / 5 + 1;
+  _month = mp < 10 ? mp + 3 : mp - 9;
+  _year = yoe + era * 400 + (_month <= 2);
+  uint32_t secs = t % 86400;
+  _hour = secs / 3600;
+  _minute = secs / 60 % 60;
+  _second = secs % 60;
+}
+
+DateTime::DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second)
+: _year(year), _month(month), _day(day), _hour(hour), _minute(minute), _second(second)
+{
+  int32_t y = year - (month <= 2);
+  int32_t era = y / 400;
+  uint32_t yoe = y - era * 400;
+  uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  _unix = (era * 146097 + doe - 719468) * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+String DateTime::timestamp(timestampOpt opt) const
+{
+  char s[20];
+  if (opt == TIMESTAMP_TIME)
+    snprintf(s, sizeof(s), "%02u:%02u:%02u", _hour, _minute, _second);
+  else if (opt == TIMESTAMP_DATE)
+    snprintf(s, sizeof(s), "%04u-%02u-%02u", _year, _month, _day);
+  else
+    snprintf(s, sizeof(s), "%04u-%02u-%02uT%02u:%02u:%02u", _year, _month, _day, _hour, _minute, _second);
+  return String(s);
+}
+
+bool Clock::ntp_sync()
+{
+  configTime("CET-1CEST,M3.5.0,M10.5.0/3", "pool.ntp.org");
+  while (time(NULL) < 1000000000)
+    delay(100);
+  adjust(DateTime(time(NULL)));
+  return true;
+}
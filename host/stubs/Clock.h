@@ -0,0 +1,46 @@
+/*
+ * Stand-in for the Clock library, a software clock running on millis()
+ */
+#ifndef HOST_CLOCK
+#define HOST_CLOCK
+
+#include <Arduino.h>
+
+class DateTime
+{
+public:
+  enum timestampOpt {
+    TIMESTAMP_FULL,
+    TIMESTAMP_TIME,
+    TIMESTAMP_DATE,
+  };
+private:
+  uint32_t _unix;
+  uint16_t _year;
+  uint8_t  _month, _day, _hour, _minute, _second;
+public:
+  DateTime(uint32_t t = 0);
+  DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0, uint8_t minute = 0, uint8_t second = 0);
+  uint16_t year() const   { return _year; };
+  uint8_t  month() const  { return _month; };
+  uint8_t  day() const    { return _day; };
+  uint8_t  hour() const   { return _hour; };
+  uint8_t  minute() const { return _minute; };
+  uint8_t  second() const { return _second; };
+  uint32_t unixtime() const { return _unix; };
+  String   timestamp(timestampOpt opt = TIMESTAMP_FULL) const;
+};
+
+class Clock
+{
+private:
+  uint32_t _unix;           // at _set
+  uint32_t _set;            // ms timestamp of the last adjust
+public:
+  Clock() : _unix(0), _set(0) {};
+  void     adjust(const DateTime &dt) { _unix = dt.unixtime(); _set = millis(); };
+  DateTime now() const { return DateTime(_unix + (millis() - _set) / 1000); };
+  bool     ntp_sync();      // blocks until SNTP has answered
+};
+
+#endif
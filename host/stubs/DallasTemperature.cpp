@@ -0,0 +1,69 @@
+#include "DallasTemperature.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// eight probes, at 20 degrees and up
+////////////////////////////////////////////////////////////////////////////////////////////
+#define PROBE(i)  { { 0x28, 0xFF, 0x64, 0x1E, 0x10, 0x00, i, 0x3C }, true, 20.0f + i }
+
+DallasTemperature::Probe DallasTemperature::bus[DALLAS_BUS] = {
+  PROBE(0), PROBE(1), PROBE(2), PROBE(3), PROBE(4), PROBE(5), PROBE(6), PROBE(7),
+};
+int      DallasTemperature::unreadable = -1;
+uint32_t DallasTemperature::searches = 0;
+
+DallasTemperature::DallasTemperature(OneWire *wire)
+: _bits(12), _wait(true)
+{
+}
+
+void DallasTemperature::begin()
+{
+  searches++;
+}
+
+uint8_t DallasTemperature::getDeviceCount()
+{
+  uint8_t count = 0;
+  for (int i=0; i<DALLAS_BUS; i++)
+    count += bus[i].present;
+  return count;
+}
+
+// in the order of the bus enumeration
+bool DallasTemperature::getAddress(uint8_t *address, uint8_t index)
+{
+  for (int i=0; i<DALLAS_BUS; i++)
+  {
+    if (!bus[i].present || index--)
+      continue;
+    if (i == unreadable)
+      return false;
+    memcpy(address, bus[i].address, sizeof(DeviceAddress));
+    return true;
+  }
+  return false;
+}
+
+DallasTemperature::Probe *DallasTemperature::_find(const uint8_t *address)
+{
+  for (int i=0; i<DALLAS_BUS; i++)
+    if (bus[i].present && memcmp(bus[i].address, address, sizeof(DeviceAddress)) == 0)
+      return &bus[i];
+  return NULL;
+}
+
+bool DallasTemperature::setResolution(const uint8_t *address, uint8_t bits)
+{
+  return _find(address) != NULL;
+}
+
+uint16_t DallasTemperature::millisToWaitForConversion(uint8_t bits)
+{
+  return 750 >> (12 - bits);
+}
+
+float DallasTemperature::getTempC(const uint8_t *address)
+{
+  Probe *probe = _find(address);
+  return probe ? probe->temp : DEVICE_DISCONNECTED_C;
+}
@@ -0,0 +1,47 @@
+/*
+ * Stand-in for the DS18B20 library, with a simulated bus shared by all instances
+ *
+ * The harness may remove probes, add new ones or make an address unreadable, to
+ * replay what happens on a real bus when a probe is replaced.
+ */
+#ifndef HOST_DALLAS_TEMPERATURE
+#define HOST_DALLAS_TEMPERATURE
+
+#include <Arduino.h>
+#include <OneWire.h>
+
+#define DALLAS_BUS            12
+#define DEVICE_DISCONNECTED_C -127.0f
+
+typedef uint8_t DeviceAddress[8];
+
+class DallasTemperature
+{
+public:
+  struct Probe {
+    DeviceAddress address;
+    bool          present;
+    float         temp;
+  };
+  static Probe  bus[DALLAS_BUS];
+  static int    unreadable;       // index of which getAddress() fails, -1 for none
+  static uint32_t searches;       // bus searches done by begin()
+
+  DallasTemperature(OneWire *wire);
+  void     begin();
+  uint8_t  getDeviceCount();
+  bool     getAddress(uint8_t *address, uint8_t index);
+  bool     setResolution(const uint8_t *address, uint8_t bits);
+  void     setResolution(uint8_t bits) { _bits = bits; };
+  uint8_t  getResolution() { return _bits; };
+  void     setWaitForConversion(bool wait) { _wait = wait; };
+  void     requestTemperatures() { if (_wait) delay(millisToWaitForConversion(_bits)); };
+  uint16_t millisToWaitForConversion(uint8_t bits);
+  float    getTempC(const uint8_t *address);
+private:
+  uint8_t  _bits;
+  bool     _wait;
+  Probe   *_find(const uint8_t *address);
+};
+
+#endif
@@ -0,0 +1,9 @@
+/*
+ * Stand-in for the DatedVersion library
+ */
+#ifndef HOST_DATED_VERSION
+#define HOST_DATED_VERSION
+
+#define DATED_VERSION(major, minor)   static const char *VERSION = #major "." #minor "-host";
+
+#endif
@@ -0,0 +1,10 @@
+#include "EEPROM.h"
+
+EEPROMClass EEPROM;
+
+// an erased flash reads as all ones
+EEPROMClass::EEPROMClass()
+: _size(0), commits(0)
+{
+  erase();
+}
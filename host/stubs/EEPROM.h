@@ -0,0 +1,28 @@
+/*
+ * Stand-in for the EEPROM emulation, kept in RAM for the duration of the run
+ */
+#ifndef HOST_EEPROM
+#define HOST_EEPROM
+
+#include <Arduino.h>
+
+#define EEPROM_HOST_SIZE  4096
+
+class EEPROMClass
+{
+private:
+  uint8_t  _data[EEPROM_HOST_SIZE];
+  size_t   _size;
+public:
+  uint32_t commits;               // writes to flash
+
+  EEPROMClass();
+  void begin(size_t size) { _size = size; };
+  uint8_t *getDataPtr() { return _data; };
+  const uint8_t *getConstDataPtr() const { return _data; };
+  bool commit() { commits++; return _size > 0; };
+  void erase() { memset(_data, 0xFF, sizeof(_data)); };
+};
+extern EEPROMClass EEPROM;
+
+#endif
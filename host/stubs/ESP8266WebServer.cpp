@@ -0,0 +1,42 @@
+#include "ESP8266WebServer.h"
+
+const char *ESP8266WebServer::_pending = NULL;
+char        ESP8266WebServer::response[WEB_SERVER_RESPONSE];
+size_t      ESP8266WebServer::length = 0;
+int         ESP8266WebServer::code = 0;
+
+void ESP8266WebServer::on(const char *uri, THandlerFunction handler)
+{
+  if (_count < WEB_SERVER_HANDLERS)
+    _handlers[_count++] = { uri, handler };
+}
+
+void ESP8266WebServer::handleClient()
+{
+  if (!_pending)
+    return;
+  const char *uri = _pending;
+  _pending = NULL;
+  length = 0;
+  response[0] = 0;
+  for (int i=0; i<_count; i++)
+    if (strcmp(_handlers[i].uri, uri) == 0) {
+      _handlers[i].handler();
+      return;
+    }
+  code = 404;
+}
+
+void ESP8266WebServer::send(int c, const char *content_type, const char *content)
+{
+  code = c;
+  sendContent(content, strlen(content));
+}
+
+void ESP8266WebServer::sendContent(const char *content, size_t size)
+{
+  size = min(size, sizeof(response) - 1 - length);
+  memcpy(response + length, content, size);
+  length += size;
+  response[length] = 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * Stand-in for the web server. The harness queues a request with get(), the next
+ * handleClient() serves it and the body ends up in response.
+ */
+#ifndef HOST_ESP8266_WEB_SERVER
+#define HOST_ESP8266_WEB_SERVER
+
+#include <Arduino.h>
+
+#define CONTENT_LENGTH_UNKNOWN  ((size_t) -1)
+#define WEB_SERVER_HANDLERS     4
+#define WEB_SERVER_RESPONSE     8192
+
+class ESP8266WebServer
+{
+public:
+  typedef std::function<void(void)> THandlerFunction;
+private:
+  struct Handler {
+    const char       *uri;
+    THandlerFunction  handler;
+  };
+  Handler   _handlers[WEB_SERVER_HANDLERS];
+  int       _count;
+  static const char *_pending;
+public:
+  static char     response[WEB_SERVER_RESPONSE];
+  static size_t   length;
+  static int      code;       // of the last response, 0 when none was served
+
+  ESP8266WebServer(int port = 80) : _count(0) {};
+  void on(const char *uri, THandlerFunction handler);
+  void begin() {};
+  void handleClient();
+  void setContentLength(size_t length) {};
+  void send(int code, const char *content_type, const char *content);
+  void sendContent(const char *content, size_t size);
+
+  static void get(const char *uri) { _pending = uri; code = 0; };
+};
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * Stand-in for the WiFi station, which connects a few seconds after begin()
+ */
+#ifndef HOST_ESP8266_WIFI
+#define HOST_ESP8266_WIFI
+
+#include <Arduino.h>
+
+#define WIFI_STA  1
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_CONNECTED = 3,
+  WL_DISCONNECTED = 6,
+} wl_status_t;
+
+class WiFiClient
+{
+};
+
+class ESP8266WiFiClass
+{
+private:
+  uint32_t _started;          // ms timestamp of begin()
+  bool     _begun;
+public:
+  bool     available;         // the access point can be reached, set by the harness
+  uint32_t delay;             // ms to connect
+
+  ESP8266WiFiClass() : _started(0), _begun(false), available(true), delay(3000) {};
+  void mode(int m) {};
+  int  getMode() const { return WIFI_STA; };
+  void begin(const char *ssid, const char *passwd) { _begun = true; _started = millis(); };
+  bool isConnected() const { return _begun && available && millis() - _started >= delay; };
+  wl_status_t status() const { return isConnected() ? WL_CONNECTED : WL_DISCONNECTED; };
+  IPAddress localIP() const { return IPAddress(192, 168, 2, 42); };
+  uint8_t *macAddress(uint8_t *mac) const;
+};
+extern ESP8266WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * Stand-in for the ArduinoHA device
+ */
+#ifndef HOST_HA_DEVICE
+#define HOST_HA_DEVICE
+
+#include <Arduino.h>
+
+class HADevice
+{
+private:
+  char        _uniqueId[32];
+  const char *_manufacturer, *_model, *_name, *_version;
+public:
+  HADevice() : _manufacturer(NULL), _model(NULL), _name(NULL), _version(NULL) { _uniqueId[0] = 0; };
+  bool setUniqueId(const byte *uniqueId, uint16_t length);
+  const char *getUniqueId() const { return _uniqueId; };
+  void setManufacturer(const char *manufacturer) { _manufacturer = manufacturer; };
+  void setModel(const char *model) { _model = model; };
+  void setName(const char *name) { _name = name; };
+  void setSoftwareVersion(const char *version) { _version = version; };
+  const char *getName() const { return _name; };
+};
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * Stand-in for the ArduinoHA mqtt client
+ *
+ * Nothing leaves the host: the posts are counted, and retained posts on subscribed topics are
+ * kept, so they are delivered again on the next connect as a broker would. The broker is up
+ * while `available` is set, the harness takes it down to test the reconnects.
+ */
+#ifndef HOST_HA_MQTT
+#define HOST_HA_MQTT
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include "HADevice.h"
+#include "device-types/HABaseDeviceType.h"
+
+#define HOST_MQTT_RETAINED  8
+#define HOST_MQTT_TOPIC     64
+#define HOST_MQTT_PAYLOAD   64
+
+class HAMqtt
+{
+private:
+  static HAMqtt *_instance;
+  HADevice &_device;
+  HABaseDeviceType **_types;
+  uint8_t   _count, _max;
+  bool      _begun, _connected;
+  void    (*_onConnected)();
+  void    (*_onMessage)(const char *topic, const uint8_t *payload, uint16_t length);
+  char      _subscribed[4][HOST_MQTT_TOPIC];
+  uint8_t   _subscriptions;
+  struct Retained {
+    char    topic[HOST_MQTT_TOPIC];
+    char    payload[HOST_MQTT_PAYLOAD];
+    uint16_t length;
+  } _retained[HOST_MQTT_RETAINED];
+  // as in PubSubClient, a message is delivered from the buffer the next packet is built in
+  char      _buffer[8 + HOST_MQTT_TOPIC + HOST_MQTT_PAYLOAD];
+  // the post under construction with beginPublish()
+  char      _topic[HOST_MQTT_TOPIC];
+  uint16_t  _length;
+  bool      _retain;
+
+  void _connect();
+  bool _matches(const char *topic) const;
+  void _retain_post(const char *topic, const char *payload, uint16_t length);
+  void _deliver(const char *topic, const char *payload, uint16_t length);
+public:
+  bool      available;      // the broker can be reached
+  uint32_t  posts;          // all posts, including the discovery configs
+  uint32_t  configs;        // discovery configs
+  uint32_t  bytes;          // payload bytes posted
+  uint32_t  connects;
+  uint32_t  failing;        // the next publish() calls fail, as with a full socket
+  void    (*observer)(const char *topic, const char *payload, bool retained);   // sees each publish()
+
+  HAMqtt(WiFiClient &client, HADevice &device, uint8_t maxDevicesTypesNb = 6);
+  static HAMqtt *instance() { return _instance; };
+  HADevice *getDevice() const { return &_device; };
+  const char *getDataPrefix() const { return "aha"; };
+  const char *getDiscoveryPrefix() const { return "homeassistant"; };
+  bool begin(const char *server, uint16_t port, const char *user, const char *password);
+  void loop();
+  bool isConnected() const { return _connected; };
+  void addDeviceType(HABaseDeviceType *type);
+  void onConnected(void (*callback)()) { _onConnected = callback; };
+  void onMessage(void (*callback)(const char *topic, const uint8_t *payload, uint16_t length)) { _onMessage = callback; };
+  bool subscribe(const char *topic);
+  bool publish(const char *topic, const char *payload, bool retained = false);
+  bool beginPublish(const char *topic, uint16_t length, bool retained = false);
+  bool writePayload(const char *data, uint16_t length);
+  bool writePayload(const uint8_t *data, uint16_t length) { return writePayload((const char *) data, length); };
+  bool endPublish();
+  // the harness posts as another client of the broker
+  void inject(const char *topic, const char *payload, bool retained);
+  const char *retained(const char *topic) const;  // the payload kept for the topic, NULL when none
+};
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * Stand-in for the UARTs of the ESP8266, WemosSerial is not used on the host
+ */
+#ifndef HOST_HARDWARE_SERIAL
+#define HOST_HARDWARE_SERIAL
+
+#include <Arduino.h>
+
+#define UART0 0
+#define UART1 1
+
+class HardwareSerial
+{
+public:
+  HardwareSerial(int uart) {};
+  size_t print(const char *s) { return strlen(s); };
+};
+
+#endif
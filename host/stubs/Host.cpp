@@ -0,0 +1,6 @@
+#include <Logging.h>
+#include <ArduinoOTA.h>
+
+bool host::verbose = false;
+
+ArduinoOTAClass ArduinoOTA;
@@ -0,0 +1,20 @@
+/*
+ * Stand-in for the status LED
+ */
+#ifndef HOST_LED
+#define HOST_LED
+
+#include <Arduino.h>
+
+class LED
+{
+public:
+  uint32_t blinks;
+
+  LED(int pin) : blinks(0) {};
+  void on() {};
+  void off() {};
+  void blink() { blinks++; };
+};
+
+#endif
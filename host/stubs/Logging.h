@@ -0,0 +1,47 @@
+/*
+ * Stand-in for the Logging library. Lines go to stdout when the harness is verbose,
+ * and to LOG_CALLBACK when LOG_REMOTE is defined, as on the device.
+ */
+#ifndef HOST_LOGGING
+#define HOST_LOGGING
+
+#include <Arduino.h>
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL 2
+#endif
+
+namespace host {
+  extern bool verbose;
+}
+
+#ifdef LOG_REMOTE
+void LOG_CALLBACK(char *msg);
+#define LOG_FORWARD(line)     LOG_CALLBACK(line)
+#else
+#define LOG_FORWARD(line)
+#endif
+
+#define LOG_REMOVE_NEWLINE(msg)   do { int _lg = strlen(msg); if (_lg && msg[_lg-1] == '\n') msg[_lg-1] = 0; } while (0)
+#define LOG_LINE(...)         do { char _line[256]; snprintf(_line, sizeof(_line), __VA_ARGS__); \
+                                   if (host::verbose) { fputs(_line, stdout); } LOG_FORWARD(_line); } while (0)
+
+#if LOG_LEVEL >= 1
+#define ERROR(...)            LOG_LINE(__VA_ARGS__)
+#else
+#define ERROR(...)
+#endif
+#if LOG_LEVEL >= 2
+#define INFO(...)             LOG_LINE(__VA_ARGS__)
+#else
+#define INFO(...)
+#endif
+#if LOG_LEVEL >= 3
+#define DEBUG(...)            LOG_LINE(__VA_ARGS__)
+#define DEBUG_BIN(s, p, lg)   do { if (host::verbose) { fputs(s, stdout); for (int _i=0; _i<(lg); _i++) printf("%02x", (p)[_i]); puts(""); } } while (0)
+#else
+#define DEBUG(...)
+#define DEBUG_BIN(s, p, lg)
+#endif
+
+#endif
@@ -0,0 +1,15 @@
+/*
+ * Stand-in for the OneWire bus, the probes are simulated by DallasTemperature
+ */
+#ifndef HOST_ONE_WIRE
+#define HOST_ONE_WIRE
+
+#include <Arduino.h>
+
+class OneWire
+{
+public:
+  OneWire(uint8_t pin) {};
+};
+
+#endif
@@ -0,0 +1,4 @@
+/*
+ * Stand-in for the String header of the core, which is part of Arduino.h here
+ */
+#include <Arduino.h>
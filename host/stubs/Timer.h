@@ -0,0 +1,19 @@
+/*
+ * Stand-in for the Timer library, passed() once the time set has elapsed
+ */
+#ifndef HOST_TIMER
+#define HOST_TIMER
+
+#include <Arduino.h>
+
+class Timer
+{
+private:
+  uint32_t _until;
+public:
+  Timer() : _until(0) {};
+  void set(uint32_t ms) { _until = millis() + ms; };
+  bool passed() const { return int32_t(millis() - _until) >= 0; };
+};
+
+#endif
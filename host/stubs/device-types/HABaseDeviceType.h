@@ -0,0 +1,45 @@
+/*
+ * Stand-in for the ArduinoHA base of all device types
+ */
+#ifndef HOST_HA_BASE_DEVICE_TYPE
+#define HOST_HA_BASE_DEVICE_TYPE
+
+#include <Arduino.h>
+#include "../utils/HASerializer.h"
+#include "../utils/HANumeric.h"
+
+class HAMqtt;
+
+class HABaseDeviceType
+{
+public:
+  enum NumberPrecision {
+    PrecisionP0 = 0,
+    PrecisionP1,
+    PrecisionP2,
+    PrecisionP3,
+  };
+private:
+  const char *_componentName;
+  const char *_uniqueId;
+  const char *_name;
+protected:
+  HASerializer *_serializer;
+
+  virtual void buildSerializer() {};
+  void destroySerializer();
+  void publishConfig();
+  bool publishOnDataTopic(const __FlashStringHelper *topic, const char *value, bool retained = false);
+public:
+  HABaseDeviceType(const __FlashStringHelper *componentName, const char *uniqueId);
+  virtual ~HABaseDeviceType() { destroySerializer(); };
+  const char *uniqueId() const { return _uniqueId; };
+  const char *componentName() const { return _componentName; };
+  const char *getName() const { return _name; };
+  void setName(const char *name) { _name = name; };
+  static HAMqtt *mqtt();
+  virtual void onMqttConnected() = 0;
+  virtual void onMqttMessage(const char *topic, const uint8_t *payload, uint16_t length) {};
+};
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * Stand-in for the ArduinoHA binary sensor
+ */
+#ifndef HOST_HA_BINARY_SENSOR
+#define HOST_HA_BINARY_SENSOR
+
+#include "HABaseDeviceType.h"
+
+class HABinarySensor : public HABaseDeviceType
+{
+private:
+  const char *_class, *_icon;
+  bool _currentState;
+
+  bool publishState(bool state);
+protected:
+  virtual void buildSerializer() override;
+public:
+  HABinarySensor(const char *uniqueId)
+  : HABaseDeviceType(F("binary_sensor"), uniqueId), _class(NULL), _icon(NULL), _currentState(false) {};
+  bool setState(bool state, bool force = false);
+  void setCurrentState(bool state) { _currentState = state; };
+  bool getCurrentState() const { return _currentState; };
+  void setDeviceClass(const char *c) { _class = c; };
+  void setIcon(const char *icon) { _icon = icon; };
+  void setExpireAfter(uint16_t s) {};
+  virtual void onMqttConnected() override;
+};
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * Stand-in for the ArduinoHA sensor, posting a string state
+ */
+#ifndef HOST_HA_SENSOR
+#define HOST_HA_SENSOR
+
+#include "HABaseDeviceType.h"
+
+class HASensor : public HABaseDeviceType
+{
+private:
+  const char *_class, *_state_class, *_icon, *_unit;
+protected:
+  virtual void buildSerializer() override;
+public:
+  HASensor(const char *uniqueId)
+  : HABaseDeviceType(F("sensor"), uniqueId), _class(NULL), _state_class(NULL), _icon(NULL), _unit(NULL) {};
+  bool setValue(const char *value);
+  void setDeviceClass(const char *c) { _class = c; };
+  void setStateClass(const char *c) { _state_class = c; };
+  void setIcon(const char *icon) { _icon = icon; };
+  void setUnitOfMeasurement(const char *u) { _unit = u; };
+  void setExpireAfter(uint16_t s) {};
+  void setForceUpdate(bool f) {};
+  virtual void onMqttConnected() override;
+};
+
+#endif
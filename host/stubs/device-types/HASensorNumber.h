@@ -0,0 +1,33 @@
+/*
+ * Stand-in for the ArduinoHA numeric sensor, keeping the last posted value
+ */
+#ifndef HOST_HA_SENSOR_NUMBER
+#define HOST_HA_SENSOR_NUMBER
+
+#include "HASensor.h"
+
+class HASensorNumber : public HASensor
+{
+private:
+  const NumberPrecision _precision;
+  HANumeric _currentValue;
+
+  bool publishValue(const HANumeric &value);
+public:
+  HASensorNumber(const char *uniqueId, const NumberPrecision precision = PrecisionP0)
+  : HASensor(uniqueId), _precision(precision) {};
+  bool setValue(const HANumeric &value, bool force = false);
+  bool setValue(int8_t value, bool force = false)   { return setValue(HANumeric(value, _precision), force); };
+  bool setValue(int16_t value, bool force = false)  { return setValue(HANumeric(value, _precision), force); };
+  bool setValue(int32_t value, bool force = false)  { return setValue(HANumeric(value, _precision), force); };
+  bool setValue(uint8_t value, bool force = false)  { return setValue(HANumeric(value, _precision), force); };
+  bool setValue(uint16_t value, bool force = false) { return setValue(HANumeric(value, _precision), force); };
+  bool setValue(uint32_t value, bool force = false) { return setValue(HANumeric(value, _precision), force); };
+  bool setValue(float value, bool force = false)    { return setValue(HANumeric(value, _precision), force); };
+  void setCurrentValue(const HANumeric &value) { _currentValue = value; };
+  template <typename T> void setCurrentValue(T value) { _currentValue = HANumeric(value, _precision); };
+  const HANumeric &getCurrentValue() const { return _currentValue; };
+  virtual void onMqttConnected() override;
+};
+
+#endif
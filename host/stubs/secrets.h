@@ -0,0 +1,6 @@
+// credentials of the sketch, not needed on the host
+#define STA_SSID    "host"
+#define STA_PASS    "host"
+#define MQTT_USER   "host"
+#define MQTT_PASS   "host"
+#define OTA_PASS    "host"
@@ -0,0 +1,20 @@
+/*
+ * Stand-in for the ArduinoHA dictionary, the short names of the discovery properties
+ */
+#ifndef HOST_HA_DICTIONARY
+#define HOST_HA_DICTIONARY
+
+#include <Arduino.h>
+
+#define AHATOFSTR(x)  (reinterpret_cast<const __FlashStringHelper *>(x))
+
+extern const char HANameProperty[];
+extern const char HAUniqueIdProperty[];
+extern const char HADeviceClassProperty[];
+extern const char HAStateClassProperty[];
+extern const char HAIconProperty[];
+extern const char HAUnitOfMeasurementProperty[];
+extern const char HAStateTopic[];
+extern const char HAConfigTopic[];
+
+#endif
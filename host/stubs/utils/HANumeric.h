@@ -0,0 +1,38 @@
+/*
+ * Stand-in for the ArduinoHA numeric, a scaled integer with its precision
+ */
+#ifndef HOST_HA_NUMERIC
+#define HOST_HA_NUMERIC
+
+#include <Arduino.h>
+
+class HANumeric
+{
+private:
+  bool     _isSet;
+  int64_t  _value;        // in units of the precision
+  uint8_t  _precision;
+public:
+  HANumeric() : _isSet(false), _value(0), _precision(0) {};
+  HANumeric(float value, uint8_t precision);
+  HANumeric(int8_t value, uint8_t precision)   : _isSet(true), _value(value), _precision(precision) {};
+  HANumeric(int16_t value, uint8_t precision)  : _isSet(true), _value(value), _precision(precision) {};
+  HANumeric(int32_t value, uint8_t precision)  : _isSet(true), _value(value), _precision(precision) {};
+  HANumeric(uint8_t value, uint8_t precision)  : _isSet(true), _value(value), _precision(precision) {};
+  HANumeric(uint16_t value, uint8_t precision) : _isSet(true), _value(value), _precision(precision) {};
+  HANumeric(uint32_t value, uint8_t precision) : _isSet(true), _value(value), _precision(precision) {};
+
+  bool     isSet() const { return _isSet; };
+  int64_t  getBaseValue() const { return _value; };
+  void     setBaseValue(int64_t value) { _isSet = true; _value = value; };
+  uint8_t  getPrecision() const { return _precision; };
+  void     setPrecision(uint8_t precision) { _precision = precision; };
+  float    toFloat() const;
+  uint16_t calculateSize() const;
+  uint16_t toStr(char *dst) const;      // as the library does, the string is not terminated
+  bool operator==(const HANumeric &other) const {
+    return _isSet == other._isSet && _value == other._value && _precision == other._precision;
+  };
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * Stand-in for the ArduinoHA serializer of the discovery configs, rendered as json
+ */
+#ifndef HOST_HA_SERIALIZER
+#define HOST_HA_SERIALIZER
+
+#include <Arduino.h>
+#include "HADictionary.h"
+
+class HABaseDeviceType;
+
+class HASerializer
+{
+public:
+  enum FlagType {
+    WithDevice = 1,
+    WithAvailability,
+    WithUniqueId,
+  };
+  enum PropertyValueType {
+    UnknownPropertyValueType = 0,
+    ConstCharPropertyValue,
+    ProgmemPropertyValue,
+  };
+private:
+  enum EntryType {
+    PropertyEntry,
+    TopicEntry,
+    FlagEntry,
+  };
+  struct Entry {
+    EntryType   type;
+    const char *property;
+    const char *value;
+    FlagType    flag;
+  };
+  HABaseDeviceType *_owner;
+  Entry     *_entries;
+  uint8_t    _count, _max;
+public:
+  HASerializer(HABaseDeviceType *deviceType, uint8_t maxEntriesNb);
+  ~HASerializer();
+  void set(const __FlashStringHelper *property, const void *value, PropertyValueType type = ConstCharPropertyValue);
+  void set(FlagType flag);
+  void topic(const __FlashStringHelper *topic);
+  int  render(char *dst, int size) const;    // the json config, returns its length
+};
+
+#endif